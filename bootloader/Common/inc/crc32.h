@@ -0,0 +1,25 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "stdint.h"
+
+/* CRC-32 (IEEE 802.3) of a whole message, the same value as crc32(0, ...) from
+   interface/Common/src/crc.c. On the K20 the CRC module does the aligned words */
+uint32_t flash_crc32(const uint8_t *data, uint32_t len);
+
+#endif
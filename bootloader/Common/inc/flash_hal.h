@@ -20,21 +20,37 @@
 
 #define START_APP_ADDRESS (0x5000)
 
+/* FLASH_PAGE_SIZE is the amount handed to flash_hal_program_page() in one call
+   and FLASH_PAGE_BUFFERS how many of those are staged in RAM. The LPC11U35 gets
+   no overlap of USB and programming: its 8KB of RAM only has room for a single
+   4KB buffer, and the flash can't be read during an IAP copy so the USB interrupt
+   (vectors and handler in flash) waits for it anyway. A whole sector per IAP copy
+   is what saves time there */
 #if defined(TARGET_LPC11U35)
   #define SECTOR_SIZE       (0x1000)
   #define NB_SECTOR         (16)
+  #define FLASH_PAGE_SIZE   (0x1000)
+  #define FLASH_PAGE_BUFFERS (1)
 
 #elif defined(TARGET_MK20DX)
   #define SECTOR_SIZE       (0x400)
   #define NB_SECTOR         (128)
+  #define FLASH_PAGE_SIZE   (0x400)
+  #define FLASH_PAGE_BUFFERS (2)
 
 #elif defined(TARGET_ATSAM3U2C)
   #define SECTOR_SIZE       (0x1000)
   #define NB_SECTOR         (32)
+  #define FLASH_PAGE_SIZE   (0x1000)
+  #define FLASH_PAGE_BUFFERS (2)
 #endif
 
 #define END_FLASH         (NB_SECTOR*SECTOR_SIZE)
 
+/* Optional image trailer in the last 12 bytes of the application region,
+   checked before the application is started (see main.c) */
+#define IMAGE_TRAILER_ADDRESS (END_FLASH - 12)
+
 int  flash_hal_init         (uint32_t clk);
 int  flash_hal_uninit       (uint32_t fnc);
 int  flash_hal_erase_sector (uint32_t adr);
@@ -22,7 +22,8 @@
 
 /* main.c */
 #define MSC_TASK_PRIORITY               (5)
-#define FLASH_PROGRAMMING_TASK_PRIORITY (10)
+/* Below the RL-USB endpoint tasks (2) so USB keeps filling the next buffer while a page is programmed */
+#define FLASH_PROGRAMMING_TASK_PRIORITY (LOWEST_PRIORITY)
 #define LED_TASK_PRIORITY (15)
 
 #define MSC_TASK_STACK (200)
@@ -20,7 +20,8 @@
 
 #define FW_BUILD "0202"
 
-uint8_t  update_html_file(void);
+uint8_t  update_html_file(uint8_t *buf, uint32_t bufsize);
+void     init_auth_config(void);
 uint8_t  get_len_string_interface(void);
 uint8_t *get_uid_string_interface(void);
 
@@ -0,0 +1,62 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "crc32.h"
+#include "crc.h"
+
+#if defined(TARGET_MK20DX)
+  #include "MK20D5.h"
+  #define HW_CRC
+#endif
+
+#ifdef HW_CRC
+// -1: not checked yet, 0: hardware result does not match, 1: use the CRC module
+static int8_t hw_crc_ok = -1;
+
+// Whole words through the K20 CRC module. Input and output are bit reversed
+//  and the result inverted, which gives the same value as crc32(0, ...)
+static uint32_t crc32_hw(const uint32_t *data, uint32_t words) {
+    SIM->SCGC6 |= SIM_SCGC6_CRC_MASK;
+    CRC0->CTRL = CRC_CTRL_TCRC_MASK | CRC_CTRL_TOT(2) | CRC_CTRL_TOTR(2) | CRC_CTRL_FXOR_MASK;
+    CRC0->GPOLY = 0x04C11DB7;
+    CRC0->CTRL |= CRC_CTRL_WAS_MASK;
+    CRC0->CRC = 0xFFFFFFFF;
+    CRC0->CTRL &= ~CRC_CTRL_WAS_MASK;
+    while (words--) {
+        CRC0->CRC = *data++;
+    }
+    return CRC0->CRC;
+}
+#endif
+
+uint32_t flash_crc32(const uint8_t *data, uint32_t len) {
+    uint32_t crc = 0;
+#ifdef HW_CRC
+    static const uint32_t check[2] = {0x34333231, 0x38373635};
+
+    // the module can only start a new message on a word boundary
+    if (!((uint32_t)data & 0x3) && (len >= 4)) {
+        if (hw_crc_ok < 0) {
+            hw_crc_ok = (crc32_hw(check, 2) == crc32(0, (const uint8_t *)check, 8));
+        }
+        if (hw_crc_ok) {
+            crc = crc32_hw((const uint32_t *)data, len / 4);
+            data += len & ~0x3;
+            len &= 0x3;
+        }
+    }
+#endif
+    return crc32(crc, data, len);
+}
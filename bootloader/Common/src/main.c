@@ -24,6 +24,7 @@
 #include "gpio.h"
 #include "version.h"
 #include "vector_table.h"
+#include "crc32.h"
 
 // Reference to our main task
 OS_TID mainTask, ledTask;
@@ -31,6 +32,16 @@ OS_TID mainTask, ledTask;
 #define INITIAL_SP      (*(uint32_t *)(START_APP_ADDRESS))
 #define RESET_HANDLER   (*(uint32_t *)(START_APP_ADDRESS + 4))
 
+// An image can end the application region with a trailer (see tools/add_image_trailer.py):
+// IMAGE_TRAILER_MAGIC, the image size from START_APP_ADDRESS and the CRC-32 of the image.
+// It stays out of the vector table, the LPC parts keep their boot checksum at offset 0x1C
+#define IMAGE_TRAILER_MAGIC     (0x4C525449)    // "ITRL"
+
+// Set to refuse images without a trailer
+#ifndef REQUIRE_IMAGE_TRAILER
+#define REQUIRE_IMAGE_TRAILER   (0)
+#endif
+
 #define TRANSFER_FINISHED_SUCCESS       (1 << 0)
 #define TRANSFER_FINISHED_FAIL          (1 << 1)
 
@@ -42,6 +53,19 @@ void main_transfer_finished(uint8_t success) {
     }
 }
 
+static uint8_t app_image_valid(void) {
+    const uint32_t *trailer = (const uint32_t *)IMAGE_TRAILER_ADDRESS;
+    uint32_t size = trailer[1];
+
+    if (trailer[0] != IMAGE_TRAILER_MAGIC) {
+        return (REQUIRE_IMAGE_TRAILER) ? 0 : 1;
+    }
+    if ((size == 0) || (size > (IMAGE_TRAILER_ADDRESS - START_APP_ADDRESS))) {
+        return 0;
+    }
+    return (flash_crc32((const uint8_t *)START_APP_ADDRESS, size) == trailer[2]);
+}
+
 __asm void modify_stack_pointer_and_start_app(uint32_t r0_sp, uint32_t r1_pc) {
     MOV SP, R0
     BX R1
@@ -65,7 +89,7 @@ __task void main_task(void) {
 	mainTask=os_tsk_self();
 	ledTask = os_tsk_create(led_task, LED_TASK_PRIORITY);
 
-    update_html_file();
+    init_auth_config();
 
     usbd_init();
     usbd_connect(__TRUE);
@@ -95,7 +119,8 @@ int main (void)
 {	
     gpio_init();
 
-    if (!gpio_get_pin_loader_state()) {
+    // stay in the bootloader when asked to or when the application is corrupt
+    if (!gpio_get_pin_loader_state() || !app_image_valid()) {
         os_sys_init(main_task);
     }
 
@@ -20,16 +20,25 @@
 #include "main.h"
 #include "tasks.h"
 #include "version.h"
+#include "intelhex.h"
+#include "crc32.h"
 
+// RAM_START and RAM_END bound the initial stack pointer of an application image
 #if defined(TARGET_LPC11U35)
   #include "LPC11Uxx.h"
   #define WANTED_SIZE_IN_KB     (64)
+  #define RAM_START             (0x10000000)
+  #define RAM_END               (0x10002000)
 #elif defined(TARGET_MK20DX)
   #include "MK20D5.h"
   #define WANTED_SIZE_IN_KB     (128)
+  #define RAM_START             (0x1FFFE000)
+  #define RAM_END               (0x20002000)
 #elif defined(TARGET_ATSAM3U2C)
   #include "sam3u.h"
   #define WANTED_SIZE_IN_KB     (128)
+  #define RAM_START             (0x20000000)
+  #define RAM_END               (0x20084000)
 #endif
 
 //------------------------------------------------------------------- CONSTANTS
@@ -39,6 +48,35 @@
 #define FLASH_PROGRAM_PAGE_SIZE         (512)
 #define MBR_BYTES_PER_SECTOR            (512)
 
+/* Staging buffers for the flash programming task. USB keeps filling one buffer
+   while the others are being programmed, so the host is only NAKed when every
+   buffer is waiting on the flash. Size and count come from the flash HAL */
+#define FLASH_BUFFER_SIZE               (FLASH_PAGE_SIZE)
+#define FLASH_BUFFER_COUNT              (FLASH_PAGE_BUFFERS)
+#define SECTORS_PER_PAGE                (FLASH_BUFFER_SIZE / MBR_BYTES_PER_SECTOR)
+
+/* Decoded data from one sector of a hex file. Two characters per byte plus
+   a record carried over from the previous sector */
+#define HEX_BIN_SIZE                    (MBR_BYTES_PER_SECTOR/2 + 64)
+
+/* Patch files (see tools/make_patch.py) replace 1KB blocks of the installed image.
+   Header, all little endian:
+     0  'D' 'P' 'A' 'T'
+     4  version (1), log2 of the block size (10), 2 reserved bytes
+     8  size of the installed image the patch applies to
+     12 CRC-32 of the installed image
+     16 size of the patched image
+     20 CRC-32 of the patched image
+     24 number of block records that follow
+     28 reserved
+   then for each changed block, in ascending order, its uint32_t index from
+   START_APP_ADDRESS followed by the new contents of the block */
+#define PATCH_MAGIC                     (0x54415044)
+#define PATCH_VERSION                   (1)
+#define PATCH_HEADER_SIZE               (32)
+#define PATCH_BLOCK_BITS                (10)
+#define PATCH_BLOCK_SIZE                (1 << PATCH_BLOCK_BITS)
+
 //--------------------------------------------------------------------- DERIVED
 
 #define MBR_NUM_NEEDED_SECTORS  (WANTED_SIZE_IN_BYTES / MBR_BYTES_PER_SECTOR)
@@ -82,6 +120,11 @@
 #   error Too many needed clusters, increase WANTED_SECTORS_PER_CLUSTER
 #endif
 
+#if ((FLASH_PAGE_SIZE % SECTOR_SIZE) || (FLASH_PAGE_SIZE % PATCH_BLOCK_SIZE))
+   /* pages are erased whole and patch blocks must not straddle them */
+#   error FLASH_PAGE_SIZE must be a multiple of the sector and patch block sizes
+#endif
+
 #if ((WANTED_SECTORS_PER_CLUSTER * MBR_BYTES_PER_SECTOR) > 32768)
 #   error Cluster size too large, must be <= 32KB
 #endif
@@ -124,6 +167,8 @@ __packed typedef struct {
 
 typedef enum {
     BIN_FILE,
+    HEX_FILE,
+    PATCH_FILE,
     PAR_FILE,
     DOW_FILE,
     CRD_FILE,
@@ -155,7 +200,7 @@ __packed typedef struct FatDirectoryEntry {
 
 //------------------------------------------------------------------------- END
 
-uint32_t BlockBuf[1024/4];
+uint32_t BlockBuf[(FLASH_BUFFER_COUNT*FLASH_BUFFER_SIZE)/4];
 
 typedef struct sector {
     const uint8_t * sect;
@@ -361,9 +406,6 @@ SECTOR sectors[] = {
 
     // Section for mac compatibility
     {sect5, sizeof(sect5)},
-
-    // contains mbed.htm
-    {(const uint8_t *)BlockBuf, 512},
 };
 
 static uint32_t size;
@@ -388,6 +430,35 @@ static uint8_t listen_msc_isr = 1;
 static uint8_t drag_success = 1;
 static uint8_t reason = 0;
 
+// buffers_queued is only written by program_page() and buffers_programmed only by the
+// flash programming task. The buffer being filled is always buffers_queued % FLASH_BUFFER_COUNT
+static volatile uint32_t buffers_queued;
+static volatile uint32_t buffers_programmed;
+// set by the flash programming task when an erase or a program fails. Later buffers are dropped
+static volatile uint8_t flash_error;
+static uint32_t buffer_address[FLASH_BUFFER_COUNT];
+
+// one bit per flash sector, set once the sector has been erased (or found blank) for this transfer
+static uint32_t sector_erased[(NB_SECTOR + 31) / 32];
+static OS_SEM free_buffers;
+
+// Intel HEX and patch files are decoded a sector at a time into the staging
+// buffers, so their sectors are received in SectorBuf instead
+static uint8_t hex_file;
+static uint8_t patch_file;
+static uint32_t decode_page;   // flash address of the page being assembled, 0 when none
+static uint32_t SectorBuf[MBR_BYTES_PER_SECTOR/4];
+static uint8_t hex_bin[HEX_BIN_SIZE];
+
+static struct {
+    uint32_t base_size;
+    uint32_t new_size;
+    uint32_t new_crc;
+    uint32_t blocks_left;
+    uint32_t block;         // index of the block being received
+    uint32_t record_idx;    // bytes of the current record received, index then data
+} patch;
+
 #define SWD_ERROR               0
 #define BAD_EXTENSION_FILE      1
 #define NOT_CONSECUTIVE_SECTORS 2
@@ -395,6 +466,10 @@ static uint8_t reason = 0;
 #define RESERVED_BITS           4
 #define BAD_START_SECTOR        5
 #define TIMEOUT                 6
+#define BAD_HEX_FILE            7
+#define BAD_PATCH_FILE          8
+#define WRONG_PATCH_BASE        9
+#define FLASH_ERROR             10
 
 static uint8_t * reason_array[] = {
     "SWD ERROR",
@@ -404,6 +479,10 @@ static uint8_t * reason_array[] = {
     "RESERVED BITS",
     "BAD START SECTOR",
     "TIMEOUT",
+    "BAD HEX FILE",
+    "BAD PATCH FILE",
+    "WRONG PATCH BASE",
+    "FLASH ERROR",
 };
 
 #define MSC_TIMEOUT_SPLIT_FILES_EVENT   (0x1000)
@@ -425,6 +504,11 @@ static OS_TID flash_programming_task_id;
 
 static void init(uint8_t jtag);
 static void initDisconnect(uint8_t success);
+static int erase_sectors_for_page(uint32_t adr, uint32_t sz);
+
+static uint8_t * fill_buffer(void) {
+    return (uint8_t *)BlockBuf + (buffers_queued % FLASH_BUFFER_COUNT)*FLASH_BUFFER_SIZE;
+}
 
 static void init(unsigned char jtag) {
     size = 0;
@@ -446,7 +530,10 @@ static void init(unsigned char jtag) {
     flash_started = 0;
     start_sector = 0;
     msc_event_timeout = 0;
-    USBD_MSC_BlockBuf   = (uint8_t *)BlockBuf;
+    hex_file = 0;
+    patch_file = 0;
+    decode_page = 0;
+    USBD_MSC_BlockBuf   = fill_buffer();
     listen_msc_isr = 1;
 }
 
@@ -477,72 +564,301 @@ static void enable_usb_irq(void){
 #endif
 }
 
-static int program_page(unsigned long adr, unsigned long sz, unsigned char *buf) {
-    // USB interrupt will then be re-enabled in the flash programming thread
-    disable_usb_irq();
-    isr_evt_set(PROGRAM_PAGE_EVENT, flash_programming_task_id);
+// Queue the buffer being filled for programming at adr and move on to the next one.
+//  Blocks the caller (and so NAKs the host) only when every buffer is in flight
+static int program_page(unsigned long adr) {
+    buffer_address[buffers_queued % FLASH_BUFFER_COUNT] = adr;
+    buffers_queued++;
+    os_evt_set(PROGRAM_PAGE_EVENT, flash_programming_task_id);
+    os_sem_wait(free_buffers, NO_TIMEOUT);
     return 0;
 }
 
+// blank the part of a partially filled page that the file did not cover
+static void pad_page(void) {
+    uint32_t used = (current_sector % SECTORS_PER_PAGE) * MBR_BYTES_PER_SECTOR;
+    memset(fill_buffer() + used, 0xff, FLASH_BUFFER_SIZE - used);
+}
+
+// wait for all queued buffers to be written before the transfer is reported. Every
+//  buffer in flight holds back one free_buffers token, so taking them all waits for it
+static void flush_pages(void) {
+    uint32_t i;
+    for (i = 1; i < FLASH_BUFFER_COUNT; i++) {
+        os_sem_wait(free_buffers, NO_TIMEOUT);
+    }
+    for (i = 1; i < FLASH_BUFFER_COUNT; i++) {
+        os_sem_send(free_buffers);
+    }
+}
+
+// An image trailer at the end of the application region from an earlier, longer image
+//  doesn't describe the new one. Erase it unless the transfer already rewrote that sector
+static void drop_stale_trailer(void) {
+    if (!flash_error && erase_sectors_for_page(IMAGE_TRAILER_ADDRESS, 12)) {
+        flash_error = 1;
+    }
+}
+
+// wait for the queued pages and report the transfer
+static void finish_transfer(void) {
+    flush_pages();
+    drop_stale_trailer();
+    if (flash_error) {
+        reason = FLASH_ERROR;
+        initDisconnect(0);
+        return;
+    }
+    initDisconnect(1);
+}
+
 static int program_sector() {
-    // if we have received two sectors, write into flash
-    if (!(current_sector % 2)) {
+    // if we have received a full page of sectors, write into flash
+    if (!(current_sector % SECTORS_PER_PAGE)) {
         //flash_erase_sector(flashPtr);
-        if (program_page(flashPtr, 1024, (uint8_t *)BlockBuf)) {
+        if (program_page(flashPtr)) {
             // even if there is an error, adapt flashptr
-            flashPtr += 1024;
+            flashPtr += FLASH_BUFFER_SIZE;
             return 1;
         }
 
         // if we just wrote the last sector -> disconnect usb
         if (current_sector == nb_sector) {
-            initDisconnect(1);
+            finish_transfer();
             return 0;
         }
 
-        flashPtr += 1024;
+        flashPtr += FLASH_BUFFER_SIZE;
 
     }
 
-    // we have to write the last sector which has a size of half a page
+    // we have to write the last sectors which only fill part of a page
     if (current_sector == nb_sector) {
-        if (current_sector % 2) {
+        if (current_sector % SECTORS_PER_PAGE) {
             //flash_erase_sector(flashPtr);
-            if (program_page(flashPtr, 1024, (uint8_t *)BlockBuf)) {
+            pad_page();
+            if (program_page(flashPtr)) {
+                return 1;
+            }
+        }
+        finish_transfer();
+    }
+    return 0;
+}
+
+// Copy decoded hex data into the page it belongs to. Pages are queued as soon as
+//  the data moves past them so only the ranges present in the file are programmed
+static int program_hex_data(uint32_t addr, const uint8_t *data, uint32_t cnt) {
+    uint32_t page, n;
+
+    while (cnt) {
+        if ((addr < START_APP_ADDRESS) || (addr >= END_FLASH)) {
+            return 1;
+        }
+        page = addr & ~(FLASH_BUFFER_SIZE - 1);
+        if (page != decode_page) {
+            // a page is erased the first time it is programmed so it can't be revisited
+            if (page < decode_page) {
                 return 1;
             }
+            if (decode_page) {
+                program_page(decode_page);
+            }
+            decode_page = page;
+            memset(fill_buffer(), 0xff, FLASH_BUFFER_SIZE);
+        }
+        n = FLASH_BUFFER_SIZE - (addr - page);
+        n = (cnt < n) ? cnt : n;
+        memcpy(fill_buffer() + (addr - page), data, n);
+        addr += n;
+        data += n;
+        cnt -= n;
+    }
+    return 0;
+}
+
+// Decode one sector of a hex file. Returns 1 on error, 0 when more sectors are
+//  expected and 2 once the end of file record has been programmed
+static int program_hex_sector(const uint8_t *buf) {
+    hexfile_parse_status_t status;
+    uint32_t size = MBR_BYTES_PER_SECTOR, parsed = 0, bin_addr = 0, bin_cnt = 0;
+
+    do {
+        status = parse_hex_blob(buf, size, &parsed, hex_bin, sizeof(hex_bin), &bin_addr, &bin_cnt);
+        if ((HEX_PARSE_OK != status) && (HEX_PARSE_EOF != status) && (HEX_PARSE_UNALIGNED != status)) {
+            return 1;
+        }
+        if (bin_cnt && program_hex_data(bin_addr, hex_bin, bin_cnt)) {
+            return 1;
+        }
+        buf += parsed;
+        size -= parsed;
+    } while (HEX_PARSE_UNALIGNED == status);
+
+    if (HEX_PARSE_EOF == status) {
+        if (decode_page) {
+            program_page(decode_page);
+        }
+        return 2;
+    }
+    return 0;
+}
+
+static uint32_t read_le32(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint8_t is_patch_start(const uint8_t *buf) {
+    return (read_le32(buf) == PATCH_MAGIC) ? 1 : 0;
+}
+
+// Check a patch header against the installed image. Returns 0 when the patch can be
+//  applied, otherwise the reason it can't
+static uint8_t start_patch(const uint8_t *buf) {
+    uint32_t base_size = read_le32(buf + 8);
+
+    if ((buf[4] != PATCH_VERSION) || (buf[5] != PATCH_BLOCK_BITS)) {
+        return BAD_PATCH_FILE;
+    }
+    patch.new_size = read_le32(buf + 16);
+    patch.new_crc = read_le32(buf + 20);
+    patch.blocks_left = read_le32(buf + 24);
+    if ((base_size > (END_FLASH - START_APP_ADDRESS)) || (patch.new_size > (END_FLASH - START_APP_ADDRESS)) ||
+        (patch.blocks_left == 0)) {
+        return BAD_PATCH_FILE;
+    }
+    if (flash_crc32((const uint8_t *)START_APP_ADDRESS, base_size) != read_le32(buf + 12)) {
+        return WRONG_PATCH_BASE;
+    }
+    patch.base_size = base_size;
+    patch.block = 0;
+    patch.record_idx = 0;
+    return 0;
+}
+
+// Move on to the page holding the next patch block. Parts of the page that the patch
+//  does not replace keep the installed image, so it starts as a copy of the flash
+static int select_patch_page(uint32_t page) {
+    uint32_t base_end = START_APP_ADDRESS + patch.base_size, n = 0;
+
+    if (page == decode_page) {
+        return 0;
+    }
+    if (page < decode_page) {
+        return 1;
+    }
+    if (decode_page) {
+        program_page(decode_page);
+    }
+    decode_page = page;
+    if (base_end > page) {
+        n = base_end - page;
+        n = (n < FLASH_BUFFER_SIZE) ? n : FLASH_BUFFER_SIZE;
+        memcpy(fill_buffer(), (const uint8_t *)page, n);
+    }
+    memset(fill_buffer() + n, 0xff, FLASH_BUFFER_SIZE - n);
+    return 0;
+}
+
+// Apply one sector of a patch file. Same return values as program_hex_sector()
+static int program_patch_sector(const uint8_t *buf) {
+    uint32_t i = 0, n, addr;
+
+    // the header was checked by start_patch()
+    if (current_sector == 1) {
+        i = PATCH_HEADER_SIZE;
+    }
+    while ((i < MBR_BYTES_PER_SECTOR) && patch.blocks_left) {
+        if (patch.record_idx < 4) {
+            patch.block |= (uint32_t)buf[i++] << (8 * patch.record_idx);
+            if (++patch.record_idx == 4) {
+                addr = START_APP_ADDRESS + (patch.block << PATCH_BLOCK_BITS);
+                if ((patch.block >= ((END_FLASH - START_APP_ADDRESS) >> PATCH_BLOCK_BITS)) ||
+                    select_patch_page(addr & ~(FLASH_BUFFER_SIZE - 1))) {
+                    return 1;
+                }
+            }
+            continue;
         }
-        initDisconnect(1);
+        addr = START_APP_ADDRESS + (patch.block << PATCH_BLOCK_BITS) + (patch.record_idx - 4);
+        n = 4 + PATCH_BLOCK_SIZE - patch.record_idx;
+        n = ((MBR_BYTES_PER_SECTOR - i) < n) ? (MBR_BYTES_PER_SECTOR - i) : n;
+        memcpy(fill_buffer() + (addr - decode_page), buf + i, n);
+        i += n;
+        patch.record_idx += n;
+        if (patch.record_idx == (4 + PATCH_BLOCK_SIZE)) {
+            patch.record_idx = 0;
+            patch.block = 0;
+            patch.blocks_left--;
+        }
+    }
+
+    if (0 == patch.blocks_left) {
+        program_page(decode_page);
+        return 2;
     }
     return 0;
 }
 
 extern uint32_t SystemCoreClock;
 
+static uint8_t sector_is_blank(uint32_t adr) {
+    const uint32_t *p = (const uint32_t *)adr;
+    uint32_t i;
+    for (i = 0; i < SECTOR_SIZE/4; i++) {
+        if (p[i] != 0xFFFFFFFF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Erase the sectors a page is about to be written to, the first time each is touched.
+//  Returns 1 if an erase failed
+static int erase_sectors_for_page(uint32_t adr, uint32_t sz) {
+    uint32_t n, end = adr + sz;
+    for (adr &= ~(SECTOR_SIZE - 1); (adr < end) && (adr < END_FLASH); adr += SECTOR_SIZE) {
+        n = adr / SECTOR_SIZE;
+        if (!(sector_erased[n / 32] & (1 << (n % 32)))) {
+            if (!sector_is_blank(adr) && flash_erase_sector_svc(adr)) {
+                return 1;
+            }
+            sector_erased[n / 32] |= (1 << (n % 32));
+        }
+    }
+    return 0;
+}
+
 __task void flash_programming_task(void) {
-    uint32_t flags = 0, i;
+    uint32_t flags = 0, idx;
     OS_RESULT res;
     flash_programming_task_id = os_tsk_self();
     while(1) {
         res = os_evt_wait_or(PROGRAM_PAGE_EVENT | FLASH_INIT_EVENT, NO_TIMEOUT);
         if (res == OS_R_EVT) {
             flags = os_evt_get();
-            if (flags & PROGRAM_PAGE_EVENT) {
-                flash_program_page_svc(flashPtr, 1024, (uint8_t *)BlockBuf);
-                enable_usb_irq();
-
-            }
-
             if (flags & FLASH_INIT_EVENT) {
-                // init flash
+                // init flash. Sectors are erased as the new binary reaches them
                 flash_hal_init(SystemCoreClock);
+                memset(sector_erased, 0, sizeof(sector_erased));
+                flash_error = 0;
+                enable_usb_irq();
+            }
 
-                // erase flash for new binary
-                for(i = START_APP_ADDRESS; i < END_FLASH; i += SECTOR_SIZE) {
-                    // TODO: failing to erase device flash
-					flash_erase_sector_svc(i);
+            if (flags & PROGRAM_PAGE_EVENT) {
+                // drain everything queued, the producer may have got ahead while we were busy
+                while (buffers_programmed != buffers_queued) {
+                    idx = buffers_programmed % FLASH_BUFFER_COUNT;
+                    // after a failure the buffers are only released, the transfer is stopping
+                    if (!flash_error) {
+                        if (erase_sectors_for_page(buffer_address[idx], FLASH_BUFFER_SIZE) ||
+                            flash_program_page_svc(buffer_address[idx], FLASH_BUFFER_SIZE, (uint8_t *)BlockBuf + idx*FLASH_BUFFER_SIZE)) {
+                            flash_error = 1;
+                        }
+                    }
+                    buffers_programmed++;
+                    os_sem_send(free_buffers);
                 }
-                enable_usb_irq();
             }
         }
     }
@@ -573,10 +889,23 @@ __task void msc_valid_file_timeout_task(void)
 
                 if (msc_event_timeout == 1) {
                     // if the program reaches this point -> it means that no sectors have been received in the meantime
-                    if (current_sector % 2) {
-                        program_page(flashPtr, 1024, (uint8_t *)BlockBuf);
+                    if (patch_file) {
+                        // the patch is incomplete, stop before the image is made any worse
+                        flush_pages();
+                        reason = BAD_PATCH_FILE;
+                        initDisconnect(0);
+                    } else {
+                        if (hex_file) {
+                            // no end of file record, program what was decoded
+                            if (decode_page) {
+                                program_page(decode_page);
+                            }
+                        } else if (current_sector % SECTORS_PER_PAGE) {
+                            pad_page();
+                            program_page(flashPtr);
+                        }
+                        finish_transfer();
                     }
-                    initDisconnect(1);
                     msc_event_timeout = 0;
                 }
             }
@@ -632,6 +961,10 @@ int jtag_init()
 static const FILE_TYPE_MAPPING file_type_infos[] = {
     { BIN_FILE, {'B', 'I', 'N'}, 0x00000000 },
     { BIN_FILE, {'b', 'i', 'n'}, 0x00000000 },
+    { HEX_FILE, {'H', 'E', 'X'}, 0x00000000 },
+    { HEX_FILE, {'h', 'e', 'x'}, 0x00000000 },
+    { PATCH_FILE, {'P', 'A', 'T'}, 0x00000000 },
+    { PATCH_FILE, {'p', 'a', 't'}, 0x00000000 },
     { PAR_FILE, {'P', 'A', 'R'}, 0x00000000 },//strange extension on win IE 9...
     { DOW_FILE, {'D', 'O', 'W'}, 0x00000000 },//strange extension on mac...
     { CRD_FILE, {'C', 'R', 'D'}, 0x00000000 },//strange extension on linux...
@@ -669,6 +1002,36 @@ static FILE_TYPE get_file_type(const FatDirectoryEntry_t* pDirEnt, uint32_t* pAd
     return SKIP_FILE;
 }
 
+// a hex file starts with a record and the usual first records are data or address records
+// The first records must decode and checksum cleanly, not just look like hex
+static uint8_t is_hex_start(const uint8_t *buf) {
+    return validate_hex_records(buf, MBR_BYTES_PER_SECTOR, 4);
+}
+
+// Files always start on a cluster boundary and an application image starts with its
+//  vector table: an initial stack pointer in RAM and handlers inside the application
+static uint8_t is_image_start(uint32_t block, const uint8_t *buf) {
+    const uint32_t *vectors = (const uint32_t *)buf;
+    uint32_t i;
+
+    if ((block < SECTORS_FIRST_FILE_IDX) || ((block - SECTORS_FIRST_FILE_IDX) % WANTED_SECTORS_PER_CLUSTER)) {
+        return 0;
+    }
+    if (is_hex_start(buf) || is_patch_start(buf)) {
+        return 1;
+    }
+    if ((vectors[0] & 0x3) || (vectors[0] <= RAM_START) || (vectors[0] > RAM_END)) {
+        return 0;
+    }
+    // reset, NMI and HardFault must all be thumb addresses in the application
+    for (i = 1; i < 4; i++) {
+        if (!(vectors[i] & 0x1) || (vectors[i] < START_APP_ADDRESS) || (vectors[i] >= END_FLASH)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
 // take a look here: http://cs.nyu.edu/~gottlieb/courses/os/kholodov-fat.html
 // to have info on fat file system
 int search_bin_file(uint8_t * root, uint8_t sector) {
@@ -704,7 +1067,7 @@ int search_bin_file(uint8_t * root, uint8_t sector) {
         // Determine file type and get the flash offset
         file_type = get_file_type(&pDirEnts[i], &offset);
 
-        if (file_type == BIN_FILE || file_type == PAR_FILE ||
+        if (file_type == BIN_FILE || file_type == HEX_FILE || file_type == PATCH_FILE || file_type == PAR_FILE ||
             file_type == DOW_FILE || file_type == CRD_FILE || file_type == SPI_FILE) {
 
             hidden_file = (pDirEnts[i].attributes & 0x02) ? 1 : 0;
@@ -752,20 +1115,12 @@ int search_bin_file(uint8_t * root, uint8_t sector) {
 
             adapt_th_sector = 0;
 
-            // on mac, with safari, we receive all the files with some more sectors at the beginning
-            // we have to move the sectors... -> 2x slower
-            if ((start_sector != 0) && (start_sector < begin_sector) && (current_sector - (begin_sector - start_sector) >= nb_sector)) {
-
-                // we need to copy all the sectors
-                // we don't listen to msd interrupt
-                listen_msc_isr = 0;
-
-//                 uint32_t move_sector_start = (begin_sector - start_sector)*MBR_BYTES_PER_SECTOR;
-                uint32_t nb_sector_to_move = (nb_sector % 2) ? nb_sector/2 + 1 : nb_sector/2;
-                for (i = 0; i < nb_sector_to_move; i++) {
-					program_page(START_APP_ADDRESS + i*1024, 1024, (uint8_t *)BlockBuf);
-                }
-                initDisconnect(1);
+            // on mac, with safari, we receive other files before the image. Sectors received
+            // ahead of the directory are only programmed from the cluster that starts an image
+            // (see is_image_start) so the file should start where we started programming
+            if ((start_sector != 0) && (start_sector < begin_sector)) {
+                reason = BAD_START_SECTOR;
+                initDisconnect(0);
                 return -1;
             }
 
@@ -835,7 +1190,8 @@ void usbd_msc_read_sect (uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
         }
         // send mbed.html
         else if (block == SECTORS_MBED_HTML_IDX) {
-            update_html_file();
+            // never rendered in a staging buffer, one may be queued for programming
+            update_html_file(buf, MBR_BYTES_PER_SECTOR);
         }
         else if (block == 9) {
             memcpy(buf, reason_array[reason], strlen((const char *)reason_array[reason]));
@@ -846,6 +1202,7 @@ void usbd_msc_read_sect (uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
 void usbd_msc_write_sect (uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
 {
     int idx_size = 0;
+    uint8_t patch_error;
 
     if (listen_msc_isr == 0)
         return;
@@ -895,6 +1252,11 @@ void usbd_msc_write_sect (uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
             return;
         }
 
+        // without a directory entry yet, skip the clusters of other files until an image starts
+        if (!flash_started && (root_dir_received_first == 0) && (block != begin_sector) && !is_image_start(block, buf)) {
+            return;
+        }
+
         if (!flash_started && (block > theoretical_start_sector)) {
             theoretical_start_sector = block;
         }
@@ -923,6 +1285,26 @@ void usbd_msc_write_sect (uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
                 flash_started = 1;
                 isr_evt_set(MSC_TIMEOUT_START_EVENT, msc_valid_file_timeout_task_id);
                 start_sector = block;
+                hex_file = is_hex_start(buf);
+                patch_file = is_patch_start(buf);
+                if (patch_file) {
+                    // refuse the patch before anything is erased
+                    patch_error = start_patch(buf);
+                    if (patch_error) {
+                        reason = patch_error;
+                        initDisconnect(0);
+                        return;
+                    }
+                }
+                if (hex_file) {
+                    reset_hex_parser();
+                }
+                if (hex_file || patch_file) {
+                    decode_page = 0;
+                    // the first sector landed in a staging buffer that the decoder is about to fill
+                    memcpy(SectorBuf, buf, MBR_BYTES_PER_SECTOR);
+                    buf = (uint8_t *)SectorBuf;
+                }
             }
 
             // at the beginning, we need theoretical_start_sector == block
@@ -953,11 +1335,58 @@ void usbd_msc_write_sect (uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
                 program_page_error = 0;
             }
 
+            // an erase or program failed in the flash programming task, stop here
+            if (flash_error) {
+                flush_pages();
+                reason = FLASH_ERROR;
+                initDisconnect(0);
+                return;
+            }
+
             previous_sector = block;
             // adapt index in buffer
             current_sector++;
-            USBD_MSC_BlockBuf = (current_sector % 2) ? (uint8_t *)BlockBuf + 512 : (uint8_t *)BlockBuf;
-            if (program_sector() == 1) {
+            if (hex_file) {
+                switch (program_hex_sector(buf)) {
+                    case 1:
+                        reason = BAD_HEX_FILE;
+                        initDisconnect(0);
+                        return;
+                    case 2:
+                        finish_transfer();
+                        break;
+                    default:
+                        break;
+                }
+            }
+            else if (patch_file) {
+                switch (program_patch_sector(buf)) {
+                    case 1:
+                        flush_pages();
+                        reason = BAD_PATCH_FILE;
+                        initDisconnect(0);
+                        return;
+                    case 2:
+                        flush_pages();
+                        drop_stale_trailer();
+                        if (flash_error) {
+                            reason = FLASH_ERROR;
+                            initDisconnect(0);
+                            return;
+                        }
+                        // the result must match the image the patch was made for
+                        if (flash_crc32((const uint8_t *)START_APP_ADDRESS, patch.new_size) != patch.new_crc) {
+                            reason = BAD_PATCH_FILE;
+                            initDisconnect(0);
+                            return;
+                        }
+                        initDisconnect(1);
+                        break;
+                    default:
+                        break;
+                }
+            }
+            else if (program_sector() == 1) {
                 if (good_file) {
                     reason = RESERVED_BITS;
                     initDisconnect(0);
@@ -966,6 +1395,12 @@ void usbd_msc_write_sect (uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
                 program_page_error = 1;
                 return;
             }
+            // after a full page program_sector() has moved on to the next staging buffer
+            if (hex_file || patch_file) {
+                USBD_MSC_BlockBuf = (uint8_t *)SectorBuf;
+            } else {
+                USBD_MSC_BlockBuf = fill_buffer() + (current_sector % SECTORS_PER_PAGE) * MBR_BYTES_PER_SECTOR;
+            }
         }
     }
 }
@@ -974,6 +1409,7 @@ void usbd_msc_init(void)
 {
     if (!task_first_started) {
         task_first_started = 1;
+        os_sem_init(free_buffers, FLASH_BUFFER_COUNT - 1);
         os_tsk_create_user(msc_valid_file_timeout_task, MSC_TASK_PRIORITY, msc_task_stack, MSC_TASK_STACK);
         os_tsk_create(flash_programming_task, FLASH_PROGRAMMING_TASK_PRIORITY);
     }
@@ -983,7 +1419,7 @@ void usbd_msc_init(void)
     USBD_MSC_BlockSize  = 512;
     USBD_MSC_BlockGroup = 1;
     USBD_MSC_BlockCount = USBD_MSC_MemorySize / USBD_MSC_BlockSize;
-    USBD_MSC_BlockBuf   = (uint8_t *)BlockBuf;
+    USBD_MSC_BlockBuf   = fill_buffer();
     USBD_MSC_MediaReady = 1;
 }
 
@@ -20,8 +20,6 @@
 #include "mbed_htm.h"
 #include "read_uid.h"
 
-extern uint8_t BlockBuf[];
-
 // Pointers to substitution strings
 const char *fw_version = (const char *)FW_BUILD;
 
@@ -192,15 +190,7 @@ static uint8_t get_html_character(HTMLCTX *h) {
     return c;
 }
 
-uint8_t update_html_file(void) {
-    // Update a file containing the version information for this firmware
-    // This assumes exclusive access to the file system (i.e. USB not enabled at this time)
-
-    HTMLCTX html;                 // HTML reader context
-    uint8_t c;                    // Current character from HTML reader
-
-    uint32_t i = 0;
-
+void init_auth_config(void) {
     if (already_unique_id == 0) {
         read_unique_id(&unique_id);
         compute_auth();
@@ -208,14 +198,25 @@ uint8_t update_html_file(void) {
         setup_string_descriptor();
         already_unique_id = 1;
     }
+}
+
+uint8_t update_html_file(uint8_t *buf, uint32_t bufsize) {
+    // Render the file containing the version information for this firmware into buf
+
+    HTMLCTX html;                 // HTML reader context
+    uint8_t c;                    // Current character from HTML reader
+
+    uint32_t i = 0;
+
+    init_auth_config();
 
     // Write file
     init_html(&html, (uint8_t *)WebSide);
 
     do {
         c=get_html_character(&html);
-        if (c != '\0') {
-            BlockBuf[i++] = c;
+        if ((c != '\0') && (i < bufsize)) {
+            buf[i++] = c;
         }
     } while (c != '\0');
 
@@ -156,7 +156,7 @@ int flash_hal_program_page (uint32_t adr, uint32_t sz, unsigned char *buf) {
 	// Return value 1 == Error
   // Seems to program page-wise
 	// 1 page seems to be 1 KB
-	// App always calls this function with 1 KB aligned start-adresses
+	// App always calls this function with FLASH_PAGE_SIZE aligned start-adresses
   // Always called with multiple of 1 page to program
   //
   NumPagesLeft = sz >> 8;    // SAM3U has 256 byte pages, CMSIS-DAP BTL/FW assumes 1 KB pages
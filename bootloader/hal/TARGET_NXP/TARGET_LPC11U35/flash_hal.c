@@ -100,6 +100,11 @@ int flash_hal_erase_sector (uint32_t adr) {
 int flash_hal_program_page (uint32_t adr, uint32_t sz, unsigned char *buf) {
   uint32_t n;
 
+  // IAP can only copy 256, 512, 1024 or 4096 bytes at a time
+  if ((sz != 256) && (sz != 512) && (sz != 1024) && (sz != 4096)) {
+      return (1);
+  }
+
 #if NO_CRP != 0
   if (adr == 0) {
       n = *((uint32_t *)(buf + CRP_ADDRESS));
@@ -124,11 +129,9 @@ int flash_hal_program_page (uint32_t adr, uint32_t sz, unsigned char *buf) {
   }
 #endif
 
-  n = GetSecNum(adr);                          // Get Sector Number
-
   IAP.cmd    = 50;                             // Prepare Sector for Write
-  IAP.par[0] = n;                              // Start Sector
-  IAP.par[1] = n;                              // End Sector
+  IAP.par[0] = GetSecNum(adr);                 // Start Sector
+  IAP.par[1] = GetSecNum(adr + sz - 1);        // End Sector
   IAP_Call (&IAP.cmd, &IAP.stat);              // Call IAP Command
   if (IAP.stat)
       return (1);                    // Command Failed
@@ -136,7 +139,7 @@ int flash_hal_program_page (uint32_t adr, uint32_t sz, unsigned char *buf) {
   IAP.cmd    = 51;                             // Copy RAM to Flash
   IAP.par[0] = adr;                            // Destination Flash Address
   IAP.par[1] = (uint32_t)buf;             // Source RAM Address
-  IAP.par[2] = 1024;                           // Fixed Page Size
+  IAP.par[2] = sz;                             // Page Size (whole sector when 4096)
   IAP.par[3] = _CCLK;                          // CCLK in kHz
   IAP_Call (&IAP.cmd, &IAP.stat);              // Call IAP Command
   if (IAP.stat)
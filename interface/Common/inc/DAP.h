@@ -180,6 +180,7 @@ typedef struct {
 
 extern          DAP_Data_t DAP_Data;            // DAP Data
 extern volatile uint8_t    DAP_TransferAbort;   // Transfer Abort Flag
+extern          uint32_t   SWD_Select;          // Last value written to DP SELECT over SWD
 
 
 // Functions
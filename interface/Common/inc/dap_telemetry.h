@@ -0,0 +1,126 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DAP_TELEMETRY_H
+#define DAP_TELEMETRY_H
+
+/** \ingroup dap_telemetry
+    @{
+ */
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+/** Counting is one increment per SWD/JTAG transfer. Set to 0 to build without it
+ */
+#ifndef DAP_TELEMETRY
+#define DAP_TELEMETRY (1)
+#endif
+
+/** Histogram of consecutive WAIT acks before the target answered otherwise
+    1, 2-3, 4-7, 8-15, 16-31 and 32 or more
+ */
+#define TELEMETRY_WAIT_BUCKETS  (6)
+
+// ack[] indexes. The values SWD_Transfer returns (DAP_TRANSFER_*)
+#define TELEMETRY_ACK_OK        (1)
+#define TELEMETRY_ACK_WAIT      (2)
+#define TELEMETRY_ACK_FAULT     (4)
+#define TELEMETRY_ACK_NONE      (7)     // SWDIO not driven by the target
+#define TELEMETRY_ACK_PARITY    (8)     // read data parity error
+
+typedef struct {
+    uint32_t ack[16];               /*!< Transfers by ACK, see TELEMETRY_ACK_ */
+    uint32_t wait_run;              /*!< WAIT acks since the last other ack */
+    uint32_t wait_hist[TELEMETRY_WAIT_BUCKETS];
+    uint32_t retry_exhausted;       /*!< Commands and host accesses that gave up while still getting WAIT */
+    uint32_t aborts;                /*!< Transfer commands cut short by DAP_TransferAbort */
+    uint32_t reset_time;            /*!< os_time_get() when the counters were cleared */
+} dap_telemetry_t;
+
+extern dap_telemetry_t dap_telemetry;
+
+/** Transfers that ended with an ACK the protocol doesn't define
+    @param none
+    @return sum of the unexpected ack counts
+ */
+static __inline uint32_t telemetry_protocol_errors(void)
+{
+    uint32_t i = 0, sum = 0;
+    for (i = 0; i < 16; i++) {
+        if ((TELEMETRY_ACK_OK != i) && (TELEMETRY_ACK_WAIT != i) && (TELEMETRY_ACK_FAULT != i) &&
+            (TELEMETRY_ACK_NONE != i) && (TELEMETRY_ACK_PARITY != i)) {
+            sum += dap_telemetry.ack[i];
+        }
+    }
+    return sum;
+}
+
+#if (DAP_TELEMETRY == 1)
+
+/** Count the ACK of a finished transfer
+    @param ack as returned by SWD_Transfer or JTAG_Transfer
+    @return none
+ */
+static __inline void telemetry_ack(uint32_t ack)
+{
+    uint32_t run = 0, bucket = 0;
+    dap_telemetry.ack[ack & 0x0f]++;
+    if (TELEMETRY_ACK_WAIT == ack) {
+        dap_telemetry.wait_run++;
+    }
+    else if (dap_telemetry.wait_run) {
+        run = dap_telemetry.wait_run;
+        dap_telemetry.wait_run = 0;
+        while ((run >>= 1) && (bucket < (TELEMETRY_WAIT_BUCKETS - 1))) {
+            bucket++;
+        }
+        dap_telemetry.wait_hist[bucket]++;
+    }
+}
+
+/** Count how a retrying transfer sequence ended, a sequence aborted during WAIT
+    retries counts as an abort only
+    @param ack last ACK of the sequence
+    @param aborted non zero when the sequence was abandoned from outside
+    @return none
+ */
+static __inline void telemetry_end(uint32_t ack, uint32_t aborted)
+{
+    if (aborted) {
+        dap_telemetry.aborts++;
+    } else if (TELEMETRY_ACK_WAIT == ack) {
+        dap_telemetry.retry_exhausted++;
+    }
+}
+
+#else
+
+#define telemetry_ack(ack)
+#define telemetry_end(ack, aborted)
+
+#endif
+
+#ifdef __cplusplus
+  }
+#endif
+
+/** @} */
+
+#endif
@@ -0,0 +1,42 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DAP_VENDOR_COMMAND_H
+#define DAP_VENDOR_COMMAND_H
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+/** How long the DAP task may wait for a request before the halt watch is due
+    @param none
+    @return RTX ticks, 0xffff (forever) when the host has not armed the watch
+ */
+uint16_t halt_watch_timeout(void);
+
+/** Poll the core halt state when the watch is armed and due. Call in between
+    requests only, it shares the debug port with them
+    @param notification packet to fill when the core is found halted
+    @return size of the notification, 0 when there is nothing to send
+ */
+uint32_t halt_watch_poll(uint8_t *notification);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
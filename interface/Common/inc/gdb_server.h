@@ -0,0 +1,29 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GDB_SERVER_H
+#define GDB_SERVER_H
+
+#include "stdint.h"
+
+// GDB remote protocol server on the virtual COM port. Built with GDB_SERVER
+void gdb_server_init(void);
+//! @return 0 when not built in or a debugger holds the debug port
+uint8_t gdb_server_enable(void);
+void gdb_server_disable(void);
+//! @return 1 while the server owns the virtual COM port
+uint8_t gdb_server_active(void);
+
+#endif
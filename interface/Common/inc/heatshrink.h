@@ -0,0 +1,90 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HEATSHRINK_H
+#define HEATSHRINK_H
+
+/** \ingroup heatshrink_decoder
+    @{
+ */
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+/** Largest window (log2 of the byte count) the decoder keeps history for.
+    The window is the only RAM the decoder needs. Images packed with a larger
+    window are rejected when the container header is parsed.
+ */
+#ifndef HEATSHRINK_MAX_WINDOW_BITS
+#define HEATSHRINK_MAX_WINDOW_BITS  (8)
+#endif
+
+/** Size of the container header that prefixes the compressed stream
+     0..2  'H' 'S' 'Z'
+     3     container version (1)
+     4     window size in bits
+     5     lookahead size in bits
+     6..7  reserved (0)
+     8..11 size of the uncompressed image (little endian)
+     12..15 reserved (0)
+ */
+#define HEATSHRINK_HEADER_SIZE      (16)
+#define HEATSHRINK_VERSION          (1)
+
+/** Type of states that the decoder can return
+    @enum heatshrink_decode_status_t
+ */
+typedef enum {
+    HS_DECODE_OK = 0,       /*!< The input buffer was completely consumed */
+    HS_DECODE_EOF,          /*!< The whole uncompressed image has been produced */
+    HS_DECODE_OUTPUT_FULL,  /*!< The output buffer is full. Consume it and call again with the unparsed input */
+    HS_DECODE_BAD_HEADER,   /*!< The container header is malformed or uses unsupported parameters */
+    HS_DECODE_FAILURE       /*!< Default state. Return of this type is unrecoverable logic error */
+}heatshrink_decode_status_t;
+
+/** Check the start of a buffer for a valid container header
+    @param buf At least HEATSHRINK_HEADER_SIZE bytes from the start of a file
+    @return 1 if the header is valid and can be decoded, 0 otherwise
+ */
+uint8_t validate_heatshrink_header(const uint8_t *buf);
+
+/** Prepare any state that is maintained for the start of a file
+    @param none
+    @return none
+ */
+void reset_heatshrink_decoder(void);
+
+/** Decompress a blob of the container into its binary equivelant
+    @param hs_blob A block of the compressed file, starting with the header on the first call
+    @param hs_blob_size The amount of valid data in the hs_blob
+    @param hs_parse_cnt The amount of hs_blob data from the call that was parsed
+    @param bin_buf Buffer the decompressed contents goes into
+    @param bin_buf_size max size of the buffer
+    @param bin_buf_cnt The amount of data in the bin_buf
+    @return A member of heatshrink_decode_status_t that describes the state of decoding
+ */
+heatshrink_decode_status_t heatshrink_decode_blob(const uint8_t *hs_blob, const uint32_t hs_blob_size, uint32_t *hs_parse_cnt, uint8_t *bin_buf, const uint32_t bin_buf_size, uint32_t *bin_buf_cnt);
+
+#ifdef __cplusplus
+  }
+#endif
+
+/** @} */
+
+#endif
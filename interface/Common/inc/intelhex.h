@@ -46,6 +46,15 @@ typedef enum {
  */
 void reset_hex_parser(void);
 
+/** Decode and checksum the records at the start of a hex file without any parser state
+    @param hex_blob A block of ascii encoded hexfile data starting with a record
+    @param hex_blob_size The amount of valid data in the hex_blob
+    @param records The number of records that must decode cleanly. Fewer are accepted when
+                   an EOF record or the end of hex_blob comes first
+    @return 1 if the records found are well formed hex records the parser can handle, 0 otherwise
+ */
+uint8_t validate_hex_records(const uint8_t *hex_blob, const uint32_t hex_blob_size, const uint32_t records);
+
 /** Convert a blob of hex data into its binary equivelant
     @param hex_blob A block of ascii encoded hexfile data
     @param hex_blob_size The amount of valid data in the hex_blob
@@ -0,0 +1,138 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROGRAM_PROFILE_H
+#define PROGRAM_PROFILE_H
+
+/** \ingroup program_profile
+    @{
+ */
+
+#include "stdint.h"
+#include "RTL.h"
+#include "DAP_config.h"
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+/** Time a drag-and-drop transfer by phase. Set to 0 to build without it
+ */
+#ifndef PROGRAM_PROFILE
+#define PROGRAM_PROFILE (1)
+#endif
+
+/** Length of an RTX tick in us. Matches OS_TICK in RTX_Config.c
+ */
+#define PROFILE_TICK_US (10000)
+
+typedef enum {
+    PROFILE_RESET = 0,      /*!< target_set_state before programming */
+    PROFILE_ALGO,           /*!< flash algorithm download and Init call */
+    PROFILE_ERASE,          /*!< EraseChip call */
+    PROFILE_DATA,           /*!< image data written to target RAM */
+    PROFILE_PROGRAM,        /*!< ProgramPage/ProgramPages calls */
+    PROFILE_VERIFY,         /*!< reading back programmed pages */
+    PROFILE_USB,            /*!< waiting for the host between blocks */
+    PROFILE_PHASES
+} profile_phase_t;
+
+typedef struct {
+    uint32_t phase_us[PROFILE_PHASES];
+    uint32_t start_us;      /*!< first block of the file */
+    uint32_t total_us;      /*!< first block to the eject */
+    uint32_t last_us;       /*!< when the last block was done with */
+    uint32_t bytes;         /*!< file data received from the host */
+    uint32_t pages;         /*!< pages programmed */
+    uint32_t page_min_us;   /*!< shortest program time of a page */
+    uint32_t page_max_us;   /*!< longest program time of a page */
+    uint8_t  active;        /*!< a transfer is being timed */
+    uint8_t  done;          /*!< the values describe a finished transfer */
+} program_profile_t;
+
+extern program_profile_t program_profile;
+
+#if (PROGRAM_PROFILE == 1)
+
+/** Free running us time stamp. The RTX tick count extended with the SysTick
+    down counter so every core has it. A board can define PROFILE_TIME_US() in
+    DAP_config.h to use something better, the DWT cycle counter for example
+ */
+static __inline uint32_t profile_time_us(void)
+{
+#ifdef PROFILE_TIME_US
+    return PROFILE_TIME_US();
+#else
+    uint32_t ticks = 0, val = 0, load = SysTick->LOAD;
+    do {
+        ticks = os_time_get();
+        val = SysTick->VAL;
+    } while (ticks != os_time_get());
+    if (load < PROFILE_TICK_US) {
+        return ticks * PROFILE_TICK_US;
+    }
+    return (ticks * PROFILE_TICK_US) + ((load - val) / ((load + 1) / PROFILE_TICK_US));
+#endif
+}
+
+/** Add the time since start to a phase
+    @param phase to charge
+    @param start profile_time_us() when the phase began
+    @return none
+ */
+static __inline void profile_phase(profile_phase_t phase, uint32_t start)
+{
+    if (program_profile.active) {
+        program_profile.phase_us[phase] += profile_time_us() - start;
+    }
+}
+
+/** Add the time since start to PROFILE_PROGRAM and track the time per page
+    @param start profile_time_us() when the program call was made
+    @param pages number of pages the call programmed
+    @return none
+ */
+static __inline void profile_program(uint32_t start, uint32_t pages)
+{
+    uint32_t elapsed = profile_time_us() - start, per_page = 0;
+    if (program_profile.active && pages) {
+        program_profile.phase_us[PROFILE_PROGRAM] += elapsed;
+        per_page = elapsed / pages;
+        if ((0 == program_profile.pages) || (per_page < program_profile.page_min_us)) {
+            program_profile.page_min_us = per_page;
+        }
+        if (per_page > program_profile.page_max_us) {
+            program_profile.page_max_us = per_page;
+        }
+        program_profile.pages += pages;
+    }
+}
+
+#else
+
+#define profile_time_us()               (0)
+#define profile_phase(phase, start)
+#define profile_program(start, pages)
+
+#endif
+
+#ifdef __cplusplus
+  }
+#endif
+
+/** @} */
+
+#endif
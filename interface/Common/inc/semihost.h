@@ -16,8 +16,12 @@
 #ifndef SEMIHOST_H
 #define SEMIHOST_H
 
+#include "stdint.h"
+
 void semihost_init(void);
 void semihost_enable(void);
 void semihost_disable(void);
+uint8_t semihost_pause(void);
+void semihost_resume(void);
 
 #endif
@@ -20,16 +20,27 @@
 
 uint8_t swd_init(void);
 uint8_t swd_init_debug(void);
+uint8_t swd_attach(void);
+// Ownership of the debug port. A debugger holds it between DAP_Connect and
+// DAP_Disconnect, the gdb server for its session and FLASH.BIN for a read
+void swd_port_init(void);
+uint8_t swd_port_take(uint16_t timeout);
+void swd_port_release(void);
+void swd_invalidate_state(void);
 uint8_t swd_read_dp(uint8_t adr, uint32_t *val);
 uint8_t swd_write_dp(uint8_t adr, uint32_t val);
 uint8_t swd_read_ap(uint32_t adr, uint32_t *val);
 uint8_t swd_write_ap(uint32_t adr, uint32_t val);
 uint8_t swd_read_memory(uint32_t address, uint8_t *data, uint32_t size);
 uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size);
+uint8_t swd_read_core_register(uint32_t n, uint32_t *val);
+uint8_t swd_write_core_register(uint32_t n, uint32_t val);
 void swd_set_target_reset(uint8_t asserted);
 uint8_t swd_is_semihost_event(uint32_t *r0, uint32_t *r1);
 uint8_t swd_semihost_restart(uint32_t r0);
 uint8_t swd_flash_syscall_exec(const FLASH_SYSCALL *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4);
+uint8_t swd_syscall_exec(const FLASH_SYSCALL *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result);
+uint8_t swd_halt_target(void);
 
 uint8_t swd_set_target_state(TARGET_RESET_STATE state);
 
@@ -28,6 +28,7 @@ typedef enum extension {
     UNKNOWN = 0,
     BIN,
     HEX,
+    HSZ,
 } extension_t;
 
 // known extension types
@@ -40,6 +41,8 @@ static const char *const known_extensions[] = {
     "bin",
     "HEX",
     "hex",
+    "HSZ",
+    "hsz",
     0,
 };
 
@@ -59,7 +62,12 @@ typedef enum target_flash_status {
     TARGET_FAIL_HEX_CKSUM,
     TARGET_FAIL_HEX_PARSER,
     TARGET_FAIL_HEX_PROGRAM,
+    TARGET_FAIL_HSZ_HEADER,
+    TARGET_FAIL_HSZ_DECODE,
+    TARGET_FAIL_VERIFY,
+    TARGET_FAIL_GDB_ACTIVE,
     TARGET_HEX_FILE_EOF,
+    TARGET_HSZ_FILE_EOF,
 }target_flash_status_t;
 
 static const char *const fail_txt_contents[] = {
@@ -76,8 +84,13 @@ static const char *const fail_txt_contents[] = {
     "Flash program address and data buffer unaligned\r\n",
     "The application file format is unknown and cannot be parsed and/or processed.\r\n",
     "The hex file cannot be decoded. Checksum calculation failure occured.\r\n",
-    "The hex file cannot be decoded. Parser logic failure occured.\r\n"
+    "The hex file cannot be decoded. Parser logic failure occured.\r\n",
     "The hex file cannot be programmed. Logic failure occurred.\r\n",
+    "The compressed file header is invalid or uses an unsupported window size.\r\n",
+    "The compressed file cannot be decoded. Decompression failure occured.\r\n",
+    "Flash verify FAILURE. The programmed contents do not match the image\r\n",
+    "The interface firmware ABORTED programming. The gdb server is using the target\r\n",
+    "",
     ""
 };
 
@@ -88,12 +101,23 @@ target_flash_status_t check_security_bits(uint32_t flashAddr, uint8_t *data);
 //@{
 uint8_t validate_bin_nvic(uint8_t *buf);
 uint8_t validate_hexfile(uint8_t *buf);
+uint8_t validate_compressed_image(uint8_t *buf);
 target_flash_status_t target_flash_init(extension_t ext);
 target_flash_status_t target_flash_uninit(void);
 target_flash_status_t target_flash_program_page(uint32_t adr, uint8_t * buf, uint32_t size);
 target_flash_status_t target_flash_erase_chip(void);
 //@}
 
+//! @brief Target RAM another routine can be loaded to and the stack to run it with.
+//! @return 0 when the flash algorithm has no RAM buffer
+uint8_t target_flash_scratch(uint32_t *buffer, uint32_t *stack);
+
+//! @brief CRC-32 of target memory, computed by the target core from the scratch RAM.
+//!  Halts the core and overwrites the scratch RAM and the core registers.
+//! @param value crc so far, 0 to start. Updated with the result
+//! @return 0 when the core could not run the routine
+uint8_t target_flash_crc(uint32_t addr, uint32_t size, uint32_t *value);
+
 #ifdef __cplusplus
   }
 #endif
@@ -45,6 +45,12 @@ typedef struct {
 
     uint32_t ram_to_flash_bytes_to_be_written;
 
+    // Optional. Entry that programs consecutive pages from program_buffer in one call
+    //  (same arguments as program_page) and the most bytes of program_buffer it may be
+    //  given. Leave as 0 to program one page per call
+    uint32_t program_pages;
+    uint32_t max_program_size;
+
 } TARGET_FLASH;
 
 //! @brief Details about the flash algorithm.
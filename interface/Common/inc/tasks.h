@@ -28,6 +28,7 @@
 #define MSC_TASK_PRIORITY           (5)
 #define TIMER_TASK_30_PRIORITY      (TIMER_TASK_PRIORITY)
 #define SEMIHOST_TASK_PRIORITY      (2)
+#define GDB_TASK_PRIORITY           (3)
 
 // trouble here is that reset for different targets is implemented differently so all targets
 //  have to use the largest stack or these have to be defined in multiple places... Not ideal
@@ -36,5 +37,6 @@
 #define DAP_TASK_STACK      (260)
 #define SERIAL_TASK_STACK   (200)
 #define MAIN_TASK_STACK     (400)
+#define GDB_TASK_STACK      (400)
 
 #endif
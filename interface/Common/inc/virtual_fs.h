@@ -115,6 +115,7 @@ extern const uint8_t mbed_redirect_file[];
 
 void configure_fail_txt(target_flash_status_t reason);
 void virtual_fs_init(void);
+void virtual_fs_read_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks);
 
 typedef struct file_transfer_state {
     uint32_t start_block;
@@ -124,6 +125,12 @@ typedef struct file_transfer_state {
     uint32_t transfer_started;
     uint32_t transfer_failed;
     extension_t file_type;
+    uint32_t start_cluster;     // first cluster of the file being programmed
+    uint32_t hint_cluster;      // a wanted dir entry can arrive before the file data
+    uint32_t hint_filesize;     //  so remember where it starts and its size
+    uint32_t chain_cluster;     // cluster the FAT chain is being followed from, 0 if not following
+    uint32_t chain_origin;      // first cluster of the chain being followed
+    uint32_t last_chain_block;  // last block of the chain learned from the FAT, 0 if unknown
 } file_transfer_state_t;
 
 extern file_transfer_state_t file_transfer_state;
@@ -14,10 +14,14 @@
  * limitations under the License.
  */
 
+#include "tasks.h"
 #include "string.h"
 #include "DAP_config.h"
 #include "DAP.h"
 #include "semihost.h"
+#include "gdb_server.h"
+#include "swd_host.h"
+#include "dap_telemetry.h"
 
 
 #define DAP_FW_VER      "1.0"   // Firmware Version
@@ -53,6 +57,7 @@
 
          DAP_Data_t DAP_Data;           // DAP Data
 volatile uint8_t    DAP_TransferAbort;  // Trasfer Abort Flag
+         dap_telemetry_t dap_telemetry; // Transfer Counters
 
 
 #ifdef DAP_VENDOR
@@ -220,7 +225,12 @@ static uint32_t DAP_Connect(uint8_t *request, uint8_t *response) {
     port = *request;
   }
 
+  gdb_server_disable();
   semihost_disable();
+  // held until DAP_Disconnect. Waits for a FLASH.BIN read in progress
+  if (DAP_Data.debug_port == DAP_PORT_DISABLED) {
+    swd_port_take(NO_TIMEOUT);
+  }
 
   switch (port) {
 #if (DAP_SWD != 0)
@@ -236,6 +246,9 @@ static uint32_t DAP_Connect(uint8_t *request, uint8_t *response) {
       break;
 #endif
     default:
+      if (DAP_Data.debug_port == DAP_PORT_DISABLED) {
+        swd_port_release();
+      }
       *response = DAP_PORT_DISABLED;
       return (1);
   }
@@ -251,6 +264,9 @@ static uint32_t DAP_Connect(uint8_t *request, uint8_t *response) {
 //   return:   number of bytes in response
 static uint32_t DAP_Disconnect(uint8_t *response) {
 
+  if (DAP_Data.debug_port != DAP_PORT_DISABLED) {
+    swd_port_release();
+  }
   DAP_Data.debug_port = DAP_PORT_DISABLED;
   PORT_OFF();
 
@@ -785,6 +801,7 @@ static uint32_t DAP_SWD_Transfer(uint8_t *request, uint8_t *response) {
   }
 
 end:
+  telemetry_end(response_value, DAP_TransferAbort);
   *(response_head+0) = (uint8_t)response_count;
   *(response_head+1) = (uint8_t)response_value;
 
@@ -984,6 +1001,7 @@ static uint32_t DAP_JTAG_Transfer(uint8_t *request, uint8_t *response) {
   }
 
 end:
+  telemetry_end(response_value, DAP_TransferAbort);
   *(response_head+0) = (uint8_t)response_count;
   *(response_head+1) = (uint8_t)response_value;
 
@@ -1073,6 +1091,7 @@ static uint32_t DAP_SWD_TransferBlock(uint8_t *request, uint8_t *response) {
   }
 
 end:
+  telemetry_end(response_value, DAP_TransferAbort);
   *(response_head+0) = (uint8_t)(response_count >> 0);
   *(response_head+1) = (uint8_t)(response_count >> 8);
   *(response_head+2) = (uint8_t) response_value;
@@ -1175,6 +1194,7 @@ static uint32_t DAP_JTAG_TransferBlock(uint8_t *request, uint8_t *response) {
   }
 
 end:
+  telemetry_end(response_value, DAP_TransferAbort);
   *(response_head+0) = (uint8_t)(response_count >> 0);
   *(response_head+1) = (uint8_t)(response_count >> 8);
   *(response_head+2) = (uint8_t) response_value;
@@ -16,6 +16,7 @@
 
 #include "DAP_config.h"
 #include "DAP.h"
+#include "dap_telemetry.h"
 
 
 // JTAG Macros
@@ -341,11 +342,14 @@ void JTAG_IR (uint32_t ir) {
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 uint8_t  JTAG_Transfer(uint32_t request, uint32_t *data) {
+  uint8_t ack;
   if (DAP_Data.fast_clock) {
-    return JTAG_TransferFast(request, data);
+    ack = JTAG_TransferFast(request, data);
   } else {
-    return JTAG_TransferSlow(request, data);
+    ack = JTAG_TransferSlow(request, data);
   }
+  telemetry_ack(ack);
+  return (ack);
 }
 
 
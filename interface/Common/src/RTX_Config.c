@@ -40,7 +40,11 @@
 //   <i> The memory space for the stack is provided by the user.
 //   <i> Default: 0
 #ifndef OS_PRIVCNT
- #define OS_PRIVCNT     4
+    #ifdef GDB_SERVER
+        #define OS_PRIVCNT     5
+    #else
+        #define OS_PRIVCNT     4
+    #endif
 #endif
 
 //   <o>Task stack size [bytes] <20-4096:8><#/4>
@@ -132,6 +136,29 @@
  #define OS_FIFOSZ      4
 #endif
 
+// <e>Task switch trace
+// ====================
+// <i> Record task switches with a time stamp in a RAM ring and keep the run time,
+// <i> switch count and stack high water mark of every task. Read over the DAP
+// <i> vendor command with tools/rtx_trace.py
+#ifndef OS_TRACE
+  #if defined(TARGET_LPC11U35)
+    #define OS_TRACE    0
+  #else
+    #define OS_TRACE    1
+  #endif
+#endif
+
+//   <o>Trace ring size <8=> 8 entries  <16=> 16 entries
+//                      <32=> 32 entries <64=> 64 entries
+//   <i> Number of task switches kept. Every entry takes 8 bytes of RAM.
+//   <i> Default: 32 entries
+#ifndef OS_TRACESZ
+ #define OS_TRACESZ     32
+#endif
+
+// </e>
+
 // </h>
 
 //------------- <<< end of configuration section >>> -----------------------
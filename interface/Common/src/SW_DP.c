@@ -16,6 +16,7 @@
 
 #include "DAP_config.h"
 #include "DAP.h"
+#include "dap_telemetry.h"
 
 
 // SW Macros
@@ -214,16 +215,25 @@ SWD_TransferFunction(Fast);
 SWD_TransferFunction(Slow);
 
 
+// DP SELECT is write only. Kept so probe side accesses can put back what the host set
+uint32_t SWD_Select;
+
 // SWD Transfer I/O
 //   request: A[3:2] RnW APnDP
 //   data:    DATA[31:0]
 //   return:  ACK[2:0]
 uint8_t  SWD_Transfer(uint32_t request, uint32_t *data) {
+  uint8_t ack;
   if (DAP_Data.fast_clock) {
-    return SWD_TransferFast(request, data);
+    ack = SWD_TransferFast(request, data);
   } else {
-    return SWD_TransferSlow(request, data);
+    ack = SWD_TransferSlow(request, data);
+  }
+  if ((ack == DAP_TRANSFER_OK) && ((request & (DAP_TRANSFER_A2 | DAP_TRANSFER_A3 | DAP_TRANSFER_RnW | DAP_TRANSFER_APnDP)) == DP_SELECT)) {
+    SWD_Select = *data;
   }
+  telemetry_ack(ack);
+  return (ack);
 }
 
 
@@ -22,6 +22,470 @@
 #include "DAP_config.h"
 #include "uart.h"
 #include "DAP.h"
+#include "dap_telemetry.h"
+#include "swd_host.h"
+#include "debug_cm.h"
+#include "crc.h"
+#include "target_flash.h"
+#include "dap_vendor_command.h"
+#include "semihost.h"
+#include "gdb_server.h"
+
+static uint8_t *put_u32(uint8_t *buf, uint32_t val)
+{
+    *buf++ = (uint8_t)(val >> 0);
+    *buf++ = (uint8_t)(val >> 8);
+    *buf++ = (uint8_t)(val >> 16);
+    *buf++ = (uint8_t)(val >> 24);
+    return buf;
+}
+
+static uint32_t get_u32(uint8_t *buf)
+{
+    return (buf[0] << 0) | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24);
+}
+
+static uint32_t telemetry_command(uint8_t *request, uint8_t *response)
+{
+    uint8_t *p = response + 2;
+    uint32_t i = 0;
+    
+    *response = ID_DAP_Vendor1;
+    *(response + 1) = DAP_OK;
+    // RTX ticks are 10ms
+    p = put_u32(p, (os_time_get() - dap_telemetry.reset_time) * 10);
+    p = put_u32(p, dap_telemetry.ack[TELEMETRY_ACK_OK]);
+    p = put_u32(p, dap_telemetry.ack[TELEMETRY_ACK_WAIT]);
+    p = put_u32(p, dap_telemetry.ack[TELEMETRY_ACK_FAULT]);
+    p = put_u32(p, dap_telemetry.ack[TELEMETRY_ACK_NONE]);
+    p = put_u32(p, dap_telemetry.ack[TELEMETRY_ACK_PARITY]);
+    p = put_u32(p, telemetry_protocol_errors());
+    for (i = 0; i < TELEMETRY_WAIT_BUCKETS; i++) {
+        p = put_u32(p, dap_telemetry.wait_hist[i]);
+    }
+    p = put_u32(p, dap_telemetry.retry_exhausted);
+    p = put_u32(p, dap_telemetry.aborts);
+    if (*(request + 1) & 0x01) {
+        memset(&dap_telemetry, 0, sizeof(dap_telemetry));
+        dap_telemetry.reset_time = os_time_get();
+    }
+    return (p - response);
+}
+
+#define TRACE_INFO      0
+#define TRACE_TASKS     1
+#define TRACE_READ      2
+#define TRACE_CLEAR     3
+#define TRACE_RECORDS   ((DAP_PACKET_SIZE - 11) / 8)
+#define TRACE_TASK_SIZE 19
+
+static uint32_t trace_command(uint8_t *request, uint8_t *response)
+{
+    uint32_t buf[3 + (TRACE_RECORDS * 2)];
+    uint32_t info[5];
+    uint32_t i = 0, n = 0, seq = 0;
+    uint8_t *p = response + 2;
+    
+    *response = ID_DAP_Vendor2;
+    *(response + 1) = DAP_OK;
+    switch (*(request + 1)) {
+        case TRACE_INFO:
+            // the idle task always exists when the trace is built in
+            if (OS_R_OK != os_trace_task(0, info)) {
+                *(response + 1) = DAP_ERROR;
+            }
+            os_trace_read(0, buf, 0);
+            p = put_u32(p, CPU_CLOCK);
+            p = put_u32(p, buf[1]);
+            p = put_u32(p, buf[2]);
+            break;
+        case TRACE_TASKS:
+            // up to 3 tasks from slot [2] on. Slot 0 is the idle task
+            p += 2;
+            for (i = *(request + 2); (i < 256) && (n < ((DAP_PACKET_SIZE - 4) / TRACE_TASK_SIZE)); i++) {
+                if (OS_R_OK != os_trace_task(i, info)) {
+                    continue;
+                }
+                *p++ = (uint8_t)(info[0] >> 0);
+                *p++ = (uint8_t)(info[0] >> 8);
+                *p++ = (uint8_t)(info[0] >> 16);
+                *p++ = (uint8_t)(info[1] >> 0);
+                *p++ = (uint8_t)(info[1] >> 8);
+                *p++ = (uint8_t)(info[1] >> 16);
+                *p++ = (uint8_t)(info[1] >> 24);
+                p = put_u32(p, info[2]);
+                p = put_u32(p, info[3]);
+                p = put_u32(p, info[4]);
+                n++;
+            }
+            *(response + 2) = (i < 256) ? i : 0;
+            *(response + 3) = n;
+            break;
+        case TRACE_READ:
+            seq = get_u32(request + 2);
+            n = os_trace_read(seq, buf, TRACE_RECORDS);
+            *p++ = n;
+            p = put_u32(p, buf[0]);
+            p = put_u32(p, buf[1]);
+            for (i = 0; i < (n * 2); i++) {
+                p = put_u32(p, buf[3 + i]);
+            }
+            break;
+        case TRACE_CLEAR:
+            os_trace_clear();
+            break;
+        default:
+            *(response + 1) = DAP_ERROR;
+            break;
+    }
+    return (p - response);
+}
+
+#define MEM_FILL        0
+#define MEM_COMPARE     1
+#define MEM_SEARCH      2
+#define MEM_CHUNK       256
+#define MEM_NONE        0xFFFFFFFF
+
+// One burst. Chunks are aligned so they never cross the MEM-AP auto increment page
+static uint32_t mem_buf[MEM_CHUNK / 4];
+// Target memory held in mem_buf for the next compressed read. Other users clear it
+static uint32_t mem_buf_addr;
+static uint32_t mem_buf_size;
+
+static uint32_t memory_command(uint8_t *request, uint8_t *response)
+{
+    uint8_t op = *(request + 1);
+    uint32_t addr = get_u32(request + 2);
+    uint32_t size = get_u32(request + 6);
+    uint32_t value = get_u32(request + 10);
+    uint32_t arg = get_u32(request + 14);
+    uint32_t done = 0, n = 0, i = 0;
+    uint32_t errors = 0, found = MEM_NONE, found_val = 0;
+    uint8_t *p = response + 2;
+    
+    *response = ID_DAP_Vendor3;
+    *(response + 1) = DAP_OK;
+    mem_buf_size = 0;
+    DAP_TransferAbort = 0;
+    if ((DAP_Data.debug_port != DAP_PORT_SWD) || (addr & 0x3) || (size & 0x3) || (op > MEM_SEARCH)) {
+        *(response + 1) = DAP_ERROR;
+        size = 0;
+    }
+    // the host may have moved SELECT and CSW with DAP_Transfer
+    swd_invalidate_state();
+    while (done < size) {
+        // a large fill or search is stopped with DAP_TransferAbort
+        if (DAP_TransferAbort) {
+            *(response + 1) = DAP_ERROR;
+            break;
+        }
+        n = MEM_CHUNK - ((addr + done) & (MEM_CHUNK - 1));
+        if (n > (size - done)) {
+            n = size - done;
+        }
+        if (MEM_FILL == op) {
+            for (i = 0; i < (n / 4); i++) {
+                mem_buf[i] = value;
+                value += arg;
+            }
+            if (!swd_write_memory(addr + done, (uint8_t *)mem_buf, n)) {
+                *(response + 1) = DAP_ERROR;
+                break;
+            }
+        } else {
+            if (!swd_read_memory(addr + done, (uint8_t *)mem_buf, n)) {
+                *(response + 1) = DAP_ERROR;
+                break;
+            }
+            for (i = 0; i < (n / 4); i++) {
+                if (MEM_COMPARE == op) {
+                    if ((mem_buf[i] != value) && (0 == errors++)) {
+                        found = addr + done + (i * 4);
+                        found_val = mem_buf[i];
+                    }
+                    value += arg;
+                } else if ((mem_buf[i] & arg) == (value & arg)) {
+                    found = addr + done + (i * 4);
+                    n = (i + 1) * 4;
+                    break;
+                }
+            }
+        }
+        done += n;
+        if ((MEM_SEARCH == op) && (found != MEM_NONE)) {
+            break;
+        }
+    }
+    p = put_u32(p, done);
+    if (MEM_COMPARE == op) {
+        p = put_u32(p, errors);
+        p = put_u32(p, found);
+        p = put_u32(p, found_val);
+    } else if (MEM_SEARCH == op) {
+        p = put_u32(p, found);
+    }
+    return (p - response);
+}
+
+#define CRC_USE_TARGET  0x01
+#define CRC_ON_PROBE    0
+#define CRC_ON_TARGET   1
+
+static uint8_t crc_on_probe(uint32_t addr, uint32_t size, uint32_t *value)
+{
+    uint32_t n = 0;
+    
+    while (size > 0) {
+        n = (size > MEM_CHUNK) ? MEM_CHUNK : size;
+        if (DAP_TransferAbort || !swd_read_memory(addr, (uint8_t *)mem_buf, n)) {
+            return 0;
+        }
+        *value = crc32(*value, (uint8_t *)mem_buf, n);
+        addr += n;
+        size -= n;
+    }
+    return 1;
+}
+
+static uint32_t crc_command(uint8_t *request, uint8_t *response)
+{
+    uint32_t addr = get_u32(request + 2);
+    uint32_t size = get_u32(request + 6);
+    uint32_t start = get_u32(request + 10);
+    uint32_t value = start;
+    
+    *response = ID_DAP_Vendor4;
+    *(response + 1) = DAP_OK;
+    *(response + 2) = CRC_ON_PROBE;
+    put_u32(response + 3, value);
+    mem_buf_size = 0;
+    DAP_TransferAbort = 0;
+    if (DAP_Data.debug_port != DAP_PORT_SWD) {
+        *(response + 1) = DAP_ERROR;
+        return (7);
+    }
+    swd_invalidate_state();
+    if ((*(request + 1) & CRC_USE_TARGET) && target_flash_crc(addr, size, &value)) {
+        *(response + 2) = CRC_ON_TARGET;
+    } else {
+        // clear any sticky error left by a target attempt and read the region instead
+        swd_write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR);
+        value = start;
+        if (!crc_on_probe(addr, size, &value)) {
+            *(response + 1) = DAP_ERROR;
+        }
+    }
+    put_u32(response + 3, value);
+    return (7);
+}
+
+#define ZREAD_CONTINUE  0x01
+#define ZREAD_LITERAL   0x00
+#define ZREAD_REPEAT    0x80
+#define ZREAD_ZERO      0xC0
+#define ZREAD_ERASED    0xE0
+#define ZREAD_MAX_FILL  8192
+#define ZREAD_MAX_REP   66
+#define ZREAD_MAX_LIT   128
+
+static uint32_t zread_command(uint8_t *request, uint8_t *response)
+{
+    uint32_t addr = get_u32(request + 2);
+    uint32_t size = get_u32(request + 6);
+    uint32_t start = addr, avail = 0, run = 0, n = 0, count = 0;
+    uint8_t *out = response + 7, *tok = NULL, *src = NULL;
+    uint8_t b = 0, kind = 0;
+    
+    *response = ID_DAP_Vendor5;
+    *(response + 1) = DAP_OK;
+    // a new dump reads the target again
+    if (!(*(request + 1) & ZREAD_CONTINUE)) {
+        mem_buf_size = 0;
+    }
+    DAP_TransferAbort = 0;
+    if (DAP_Data.debug_port != DAP_PORT_SWD) {
+        *(response + 1) = DAP_ERROR;
+        size = 0;
+    }
+    swd_invalidate_state();
+    while ((addr - start) < size) {
+        if (DAP_TransferAbort) {
+            *(response + 1) = DAP_ERROR;
+            break;
+        }
+        if ((addr < mem_buf_addr) || (addr >= (mem_buf_addr + mem_buf_size))) {
+            mem_buf_addr = addr;
+            mem_buf_size = MEM_CHUNK - (addr & (MEM_CHUNK - 1));
+            if (mem_buf_size > (size - (addr - start))) {
+                mem_buf_size = size - (addr - start);
+            }
+            if (!swd_read_memory(mem_buf_addr, (uint8_t *)mem_buf, mem_buf_size)) {
+                mem_buf_size = 0;
+                *(response + 1) = DAP_ERROR;
+                break;
+            }
+        }
+        src = (uint8_t *)mem_buf + (addr - mem_buf_addr);
+        avail = mem_buf_addr + mem_buf_size - addr;
+        if (avail > (size - (addr - start))) {
+            avail = size - (addr - start);
+        }
+        b = src[0];
+        for (run = 1; (run < avail) && (src[run] == b); run++);
+        kind = (0x00 == b) ? ZREAD_ZERO : ((0xFF == b) ? ZREAD_ERASED : ZREAD_REPEAT);
+        n = 0;
+        // runs carry on across reads by growing the last token
+        if ((NULL != tok) && (kind != ZREAD_REPEAT) && ((*tok & 0xE0) == kind)) {
+            count = (((*tok & 0x1F) << 8) | *(tok + 1)) + 1;
+            n = ((ZREAD_MAX_FILL - count) < run) ? (ZREAD_MAX_FILL - count) : run;
+            count += n - 1;
+            *tok = kind | (count >> 8);
+            *(tok + 1) = (uint8_t)count;
+        } else if ((NULL != tok) && ((*tok & 0xC0) == ZREAD_REPEAT) && (*(tok + 1) == b)) {
+            count = (*tok & 0x3F) + 3;
+            n = ((ZREAD_MAX_REP - count) < run) ? (ZREAD_MAX_REP - count) : run;
+            *tok += n;
+        } else if ((NULL != tok) && ((*tok & 0x80) == ZREAD_LITERAL) && ((*tok + 1) < ZREAD_MAX_LIT) && (run < 3) &&
+                   ((ZREAD_REPEAT == kind) || (run < 2))) {
+            if ((out + 1) > (response + DAP_PACKET_SIZE)) {
+                break;
+            }
+            *tok += 1;
+            *out++ = b;
+            n = 1;
+        }
+        if (0 == n) {
+            // a new token always takes two bytes
+            if ((out + 2) > (response + DAP_PACKET_SIZE)) {
+                break;
+            }
+            tok = out;
+            if ((kind != ZREAD_REPEAT) && (run >= 2)) {
+                n = (run > ZREAD_MAX_FILL) ? ZREAD_MAX_FILL : run;
+                *out++ = kind | ((n - 1) >> 8);
+                *out++ = (uint8_t)(n - 1);
+            } else if (run >= 3) {
+                n = (run > ZREAD_MAX_REP) ? ZREAD_MAX_REP : run;
+                *out++ = ZREAD_REPEAT | (n - 3);
+                *out++ = b;
+            } else {
+                n = 1;
+                *out++ = ZREAD_LITERAL;
+                *out++ = b;
+            }
+        }
+        addr += n;
+    }
+    *(response + 2) = (uint8_t)(out - (response + 7));
+    put_u32(response + 3, addr - start);
+    return (out - response);
+}
+
+#define NVIC_Addr       (0xe000e000)
+#define DBG_Addr        (0xe000edf0)
+#define HALT_EVENT      0x01
+
+static uint16_t halt_period;        // RTX ticks between polls, 0 when not armed
+static uint32_t halt_armed_time;
+static uint32_t halt_last_poll;
+
+// Read DHCSR and put SELECT, CSW and TAR back the way the host left them
+static uint8_t halt_read(uint32_t addr, uint32_t *val)
+{
+    uint32_t select = SWD_Select, csw = 0, tar = 0;
+    uint8_t ok = 0;
+    
+    swd_invalidate_state();
+    if (swd_read_ap(AP_CSW, &csw) && swd_read_ap(AP_TAR, &tar)) {
+        ok = swd_read_memory(addr, (uint8_t *)val, 4);
+        if (!ok) {
+            *val = 0;
+            swd_write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR);
+        }
+        swd_invalidate_state();
+        swd_write_ap(AP_CSW, csw);
+        swd_write_ap(AP_TAR, tar);
+    }
+    swd_write_dp(DP_SELECT, select);
+    return ok;
+}
+
+uint16_t halt_watch_timeout(void)
+{
+    uint32_t elapsed = os_time_get() - halt_last_poll;
+    
+    if (0 == halt_period) {
+        return 0xffff;
+    }
+    return (elapsed >= halt_period) ? 1 : (halt_period - elapsed);
+}
+
+uint32_t halt_watch_poll(uint8_t *notification)
+{
+    uint32_t dhcsr = 0, dfsr = 0;
+    
+    if ((0 == halt_period) || ((os_time_get() - halt_last_poll) < halt_period)) {
+        return 0;
+    }
+    halt_last_poll = os_time_get();
+    // the host let go of the target
+    if (DAP_Data.debug_port != DAP_PORT_SWD) {
+        halt_period = 0;
+        return 0;
+    }
+    if (!halt_read(DBG_HCSR, &dhcsr) || !(dhcsr & S_HALT)) {
+        return 0;
+    }
+    // one notification per arm, the host arms again after resuming the core
+    halt_period = 0;
+    halt_read(NVIC_DFSR, &dfsr);
+    *notification = ID_DAP_Vendor6;
+    *(notification + 1) = HALT_EVENT;
+    put_u32(notification + 2, dhcsr);
+    put_u32(notification + 6, dfsr);
+    put_u32(notification + 10, (os_time_get() - halt_armed_time) * 10);
+    return (14);
+}
+
+static uint32_t halt_command(uint8_t *request, uint8_t *response)
+{
+    uint32_t ms = (*(request + 1) << 0) | (*(request + 2) << 8);
+    uint32_t dhcsr = 0;
+    
+    *response = ID_DAP_Vendor6;
+    *(response + 1) = DAP_OK;
+    *(response + 2) = 0;
+    halt_period = 0;
+    if ((DAP_Data.debug_port != DAP_PORT_SWD) || !halt_read(DBG_HCSR, &dhcsr)) {
+        *(response + 1) = DAP_ERROR;
+    } else if ((ms != 0) && !(dhcsr & S_HALT)) {
+        // RTX ticks are 10ms
+        halt_period = (ms + 9) / 10;
+        halt_armed_time = os_time_get();
+        halt_last_poll = halt_armed_time;
+        *(response + 2) = 1;
+    }
+    put_u32(response + 3, dhcsr);
+    return (7);
+}
+
+static uint32_t gdb_command(uint8_t *request, uint8_t *response)
+{
+    *response = ID_DAP_Vendor7;
+    *(response + 1) = DAP_OK;
+    if (*(request + 1)) {
+        if (!gdb_server_enable()) {
+            *(response + 1) = DAP_ERROR;
+        }
+    } else if (gdb_server_active()) {
+        gdb_server_disable();
+        // the target is free again, as after DAP_Disconnect
+        semihost_enable();
+    }
+    *(response + 2) = gdb_server_active();
+    return (3);
+}
 
 // Process DAP Vendor command and prepare response
 // Default function (can be overridden)
@@ -41,6 +505,89 @@ uint32_t DAP_ProcessVendorCommand(uint8_t *request, uint8_t *response) {
         return (len + 2);
     }
 
+    // SWD/JTAG transfer counters
+    //  request:  [1] bit 0 set clears the counters after they are read
+    //  response: [1] DAP_OK then 32 bit little endian values. Time since the counters
+    //            were cleared in ms, acks OK, WAIT, FAULT, no ack, parity error, other
+    //            protocol errors, the WAIT run histogram (1, 2-3, 4-7, 8-15, 16-31, 32+),
+    //            retries exhausted and transfer aborts
+    else if (*request == ID_DAP_Vendor1) {
+        return telemetry_command(request, response);
+    }
+
+    // RTX task switch trace (OS_TRACE in RTX_Config.c). Times are processor clock cycles
+    //  request:  [1] 0 info, 1 tasks, 2 read switches, 3 clear
+    //  info:     [1] DAP_OK or DAP_ERROR when not built in, clock Hz, now, time of the last clear
+    //  tasks:    request [2] first slot. [2] next slot to ask for (0 when done), [3] count,
+    //            then per task id, priority, state, stack size, stack used (16 bit), entry
+    //            address, run time, times switched in
+    //  read:     request [2..5] first switch number. [2] count, number of the first switch
+    //            returned, now, then per switch the time and from id | to id << 8 | cause << 16
+    //  clear:    restarts the run times and the switch numbering
+    else if (*request == ID_DAP_Vendor2) {
+        return trace_command(request, response);
+    }
+
+    // Memory fill, compare and search run on the probe so only the result crosses USB.
+    //  Word i of the region stands for value + i * step, so step 0 is a constant pattern
+    //  and value = address, step = 4 is an address-in-address test
+    //  request:  [1] 0 fill, 1 compare, 2 search, [2..5] address, [6..9] size in bytes,
+    //            both word aligned, [10..13] value, [14..17] step (search: mask)
+    //  response: [1] DAP_OK or DAP_ERROR, [2..5] bytes done, then
+    //            compare: mismatching words, address of the first one and the value read there
+    //            search:  address of the first word with (word & mask) == (value & mask)
+    //            Addresses are 0xFFFFFFFF when there is none. SELECT, CSW and TAR are left
+    //            changed and a FAULT leaves the sticky error for the host to clear
+    else if (*request == ID_DAP_Vendor3) {
+        return memory_command(request, response);
+    }
+
+    // CRC-32 of target memory, the same as crc32() in crc.c. The probe reads the region and
+    //  computes it, leaving the target running. On request the target core computes it
+    //  instead from the flash algorithm program buffer: that halts the core, overwrites the
+    //  RAM there and the core registers and leaves it halted. When that RAM can not be used
+    //  the probe computes it
+    //  request:  [1] bit 0 set computes on the target (target halted and its RAM clobbered),
+    //            [2..5] address, [6..9] size in bytes, [10..13] crc to continue from, 0 to start
+    //  response: [1] DAP_OK or DAP_ERROR, [2] 1 computed by the target, 0 by the probe,
+    //            [3..6] crc
+    else if (*request == ID_DAP_Vendor4) {
+        return crc_command(request, response);
+    }
+
+    // Compressed memory read. Reads what fits in one response from the start of the region
+    //  request:  [1] bit 0 set when continuing the previous read (reuses the data the probe
+    //            holds), [2..5] address, [6..9] size in bytes
+    //  response: [1] DAP_OK or DAP_ERROR, [2] stream length, [3..6] bytes of the region the
+    //            stream covers, then the stream. Tokens:
+    //            0nnnnnnn               n + 1 literal bytes follow
+    //            10nnnnnn b             n + 3 copies of byte b
+    //            110nnnnn nnnnnnnn      n + 1 bytes of 0x00
+    //            111nnnnn nnnnnnnn      n + 1 bytes of 0xFF
+    else if (*request == ID_DAP_Vendor5) {
+        return zread_command(request, response);
+    }
+
+    // Halt watch. The probe polls DHCSR between requests instead of the host and sends
+    //  an unrequested packet when it finds the core halted. Only for SWD connections
+    //  request:  [1..2] poll interval in ms, rounded up to the 10ms RTX tick. 0 disarms
+    //  response: [1] DAP_OK or DAP_ERROR, [2] 1 armed, 0 not (core already halted),
+    //            [3..6] DHCSR
+    //  notification: [1] 0x01 halted, [2..5] DHCSR, [6..9] DFSR, [10..13] ms since armed.
+    //            Sent once, the watch disarms itself
+    else if (*request == ID_DAP_Vendor6) {
+        return halt_command(request, response);
+    }
+
+    // GDB remote protocol server (GDB_SERVER builds). The virtual COM port carries gdb
+    //  packets instead of the target UART while it runs. DAP_Connect stops it
+    //  request:  [1] 1 start, 0 stop
+    //  response: [1] DAP_OK or DAP_ERROR when not built in or a debugger holds the port,
+    //            [2] 1 running
+    else if (*request == ID_DAP_Vendor7) {
+        return gdb_command(request, response);
+    }
+
     // else return invalid command
     else {
         *response = ID_DAP_Invalid;
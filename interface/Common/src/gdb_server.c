@@ -0,0 +1,966 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifdef GDB_SERVER
+
+#include "RTL.h"
+#include "rl_usb.h"
+#include "string.h"
+
+#include "tasks.h"
+#include "main.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "debug_cm.h"
+#include "swd_host.h"
+#include "target_reset.h"
+#include "target_config.h"
+#include "target_flash.h"
+#include "semihost.h"
+#include "virtual_fs.h"
+#include "gdb_server.h"
+
+#define NVIC_Addr           (0xe000e000)
+#define DBG_Addr            (0xe000edf0)
+
+// Flash Patch and Breakpoint unit
+#define FP_CTRL             (0xe0002000)
+#define FP_COMP0            (0xe0002008)
+#define FP_KEY              0x00000002
+#define FP_ENABLE           0x00000001
+
+#define FLAGS_GDB_START     (1)
+#define FLAGS_GDB_STOP      (2)
+
+#define GDB_PACKET_SIZE     256     // payload of the largest packet either way
+#define GDB_FLASH_BLOCK     512     // bytes per target_flash_program_page call, as the MSC does
+#define GDB_BREAKPOINTS     8       // FPB code comparators used at most
+#define GDB_REGS            17      // r0-r12, sp, lr, pc, xpsr. DCRSR numbers them the same
+#define GDB_STEP_POLLS      100
+#define GDB_INTERRUPT       0x03
+
+#define SIGINT              2
+#define SIGTRAP             5
+
+typedef enum {
+    RX_IDLE,
+    RX_DATA,
+    RX_CSUM_HI,
+    RX_CSUM_LO
+} rx_state_t;
+
+static const char target_xml[] =
+    "<?xml version=\"1.0\"?><!DOCTYPE target SYSTEM \"gdb-target.dtd\"><target>"
+    "<architecture>arm</architecture><feature name=\"org.gnu.gdb.arm.m-profile\">"
+    "<reg name=\"r0\" bitsize=\"32\"/><reg name=\"r1\" bitsize=\"32\"/><reg name=\"r2\" bitsize=\"32\"/>"
+    "<reg name=\"r3\" bitsize=\"32\"/><reg name=\"r4\" bitsize=\"32\"/><reg name=\"r5\" bitsize=\"32\"/>"
+    "<reg name=\"r6\" bitsize=\"32\"/><reg name=\"r7\" bitsize=\"32\"/><reg name=\"r8\" bitsize=\"32\"/>"
+    "<reg name=\"r9\" bitsize=\"32\"/><reg name=\"r10\" bitsize=\"32\"/><reg name=\"r11\" bitsize=\"32\"/>"
+    "<reg name=\"r12\" bitsize=\"32\"/><reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+    "<reg name=\"lr\" bitsize=\"32\"/><reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+    "<reg name=\"xpsr\" bitsize=\"32\"/></feature></target>";
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static OS_TID gdb_task;
+static OS_SEM gdb_stopped_sem;
+static uint8_t gdb_enabled;
+static uint8_t gdb_stop;
+static U64 stk_gdb_task[GDB_TASK_STACK/8];
+
+static uint8_t rx[GDB_PACKET_SIZE + 1];
+static uint32_t rx_len;
+static rx_state_t rx_state;
+static uint8_t rx_sum;
+static uint8_t rx_csum;
+// "$payload#cs" of the last packet sent, kept for a resend
+static uint8_t tx[GDB_PACKET_SIZE + 4];
+static uint32_t tx_len;
+static uint8_t *const reply = tx + 1;
+static uint8_t no_ack;
+
+static uint8_t running;
+static uint32_t last_poll;
+
+static uint32_t bp_addr[GDB_BREAKPOINTS];
+static uint8_t bp_used;             // bit per comparator
+static uint8_t bp_count;            // 0 until the FPB is set up
+static uint8_t fp_rev;
+
+static uint8_t flash_open;
+static uint8_t flash_dirty;
+static uint32_t flash_base;         // flash offset of flash_buf
+static uint32_t flash_done;         // flash offset everything below has been programmed
+static uint8_t flash_buf[GDB_FLASH_BLOCK];
+
+static int32_t hex_val(uint8_t c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Parse a hex number and step past it
+static uint32_t get_hex(uint8_t **p)
+{
+    uint32_t val = 0;
+    int32_t d;
+
+    while ((d = hex_val(**p)) >= 0) {
+        val = (val << 4) | d;
+        (*p)++;
+    }
+    return val;
+}
+
+static uint8_t *put_hex(uint8_t *out, uint32_t val, uint32_t digits)
+{
+    while (digits--) {
+        *out++ = hex_digits[(val >> (digits * 4)) & 0xf];
+    }
+    return out;
+}
+
+// Two hex digits per byte. Each byte is read before its digits are written so the
+//  input may sit in the upper half of the output
+static uint8_t *put_bytes(uint8_t *out, const uint8_t *in, uint32_t len)
+{
+    uint8_t b;
+
+    while (len--) {
+        b = *in++;
+        *out++ = hex_digits[b >> 4];
+        *out++ = hex_digits[b & 0xf];
+    }
+    return out;
+}
+
+static uint8_t *put_str(uint8_t *out, const char *s)
+{
+    while (*s) {
+        *out++ = *s++;
+    }
+    return out;
+}
+
+// Decode len bytes from twice as many hex digits in place
+static uint8_t decode_hex(uint8_t *buf, uint32_t len)
+{
+    uint32_t i;
+    int32_t hi, lo;
+
+    for (i = 0; i < len; i++) {
+        hi = hex_val(buf[2 * i]);
+        lo = hex_val(buf[2 * i + 1]);
+        if ((hi < 0) || (lo < 0)) {
+            return 0;
+        }
+        buf[i] = (hi << 4) | lo;
+    }
+    return 1;
+}
+
+// Undo the '}' escapes of binary data in place
+static uint32_t unescape(uint8_t *buf, uint32_t len)
+{
+    uint32_t i, n = 0;
+
+    for (i = 0; i < len; i++) {
+        if (('}' == buf[i]) && ((i + 1) < len)) {
+            buf[n++] = buf[++i] ^ 0x20;
+        } else {
+            buf[n++] = buf[i];
+        }
+    }
+    return n;
+}
+
+static uint8_t is_cmd(const char *cmd)
+{
+    return (0 == strncmp((const char *)rx, cmd, strlen(cmd)));
+}
+
+static void port_write(const uint8_t *buf, uint32_t len)
+{
+    int32_t n;
+
+    while (len && !gdb_stop) {
+        n = USBD_CDC_ACM_DataSend(buf, len);
+        if (n <= 0) {
+            // send buffer full. Give the host a tick to drain it
+            if (OS_R_EVT == os_evt_wait_or(FLAGS_GDB_STOP, 1)) {
+                gdb_stop = 1;
+            }
+            continue;
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+// Frame the len bytes at reply and send them
+static void send_packet(uint32_t len)
+{
+    uint8_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        sum += reply[i];
+    }
+    tx[0] = '$';
+    tx[len + 1] = '#';
+    put_hex(&tx[len + 2], sum, 2);
+    tx_len = len + 4;
+    port_write(tx, tx_len);
+    main_blink_cdc_led(0);
+}
+
+static void send_str(const char *s)
+{
+    send_packet(put_str(reply, s) - reply);
+}
+
+static void send_error(void)
+{
+    // a faulted access leaves the sticky error set
+    swd_write_dp(DP_ABORT, STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR);
+    send_str("E01");
+}
+
+static void send_stop(uint8_t signal)
+{
+    reply[0] = 'S';
+    put_hex(reply + 1, signal, 2);
+    send_packet(3);
+}
+
+static uint8_t read_word(uint32_t addr, uint32_t *val)
+{
+    return swd_read_memory(addr, (uint8_t *)val, 4);
+}
+
+static uint8_t write_word(uint32_t addr, uint32_t val)
+{
+    return swd_write_memory(addr, (uint8_t *)&val, 4);
+}
+
+static uint8_t resume(uint8_t step)
+{
+    uint32_t val = 0, i;
+
+    // C_MASKINTS may only change while halted. A step keeps interrupts masked so it
+    //  does not end up in an exception handler
+    if (!write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT | (step ? C_MASKINTS : 0))) {
+        return 0;
+    }
+    if (!write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | (step ? (C_MASKINTS | C_STEP) : 0))) {
+        return 0;
+    }
+    running = 1;
+    last_poll = os_time_get();
+    for (i = 0; step && (i < GDB_STEP_POLLS); i++) {
+        if (!read_word(DBG_HCSR, &val)) {
+            return 0;
+        }
+        if (val & S_HALT) {
+            running = 0;
+            break;
+        }
+    }
+    return 1;
+}
+
+// Report a halt of the running core, once per RTX tick at most
+static void poll_halt(void)
+{
+    uint32_t val = 0;
+
+    if (!running || (os_time_get() == last_poll)) {
+        return;
+    }
+    last_poll = os_time_get();
+    if (read_word(DBG_HCSR, &val) && (val & S_HALT)) {
+        running = 0;
+        send_stop(SIGTRAP);
+    }
+}
+
+static void interrupt(void)
+{
+    if (running) {
+        running = 0;
+        swd_halt_target();
+        send_stop(SIGINT);
+    }
+}
+
+static uint8_t fpb_setup(void)
+{
+    uint32_t ctrl = 0;
+
+    if (bp_count) {
+        return 1;
+    }
+    if (!read_word(FP_CTRL, &ctrl)) {
+        return 0;
+    }
+    bp_count = ((ctrl >> 8) & 0x70) | ((ctrl >> 4) & 0x0f);
+    if (bp_count > GDB_BREAKPOINTS) {
+        bp_count = GDB_BREAKPOINTS;
+    }
+    fp_rev = ctrl >> 28;
+    bp_used = 0;
+    return (bp_count && write_word(FP_CTRL, FP_KEY | FP_ENABLE));
+}
+
+static uint8_t set_breakpoint(uint32_t addr)
+{
+    uint32_t comp, i;
+
+    if (!fpb_setup()) {
+        return 0;
+    }
+    if (0 == fp_rev) {
+        // version 1 only reaches code below 0x20000000 and matches one halfword of a word
+        if (addr >= 0x20000000) {
+            return 0;
+        }
+        comp = (addr & 0x1ffffffc) | ((addr & 2) ? 0x80000000 : 0x40000000) | 1;
+    } else {
+        comp = (addr & ~1) | 1;
+    }
+    for (i = 0; i < bp_count; i++) {
+        if (!(bp_used & (1 << i))) {
+            if (!write_word(FP_COMP0 + (i * 4), comp)) {
+                return 0;
+            }
+            bp_used |= (1 << i);
+            bp_addr[i] = addr;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint8_t clear_breakpoint(uint32_t addr)
+{
+    uint32_t i;
+
+    for (i = 0; i < bp_count; i++) {
+        if ((bp_used & (1 << i)) && (bp_addr[i] == addr)) {
+            bp_used &= ~(1 << i);
+            return write_word(FP_COMP0 + (i * 4), 0);
+        }
+    }
+    return 1;
+}
+
+static void clear_breakpoints(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < bp_count; i++) {
+        if (bp_used & (1 << i)) {
+            write_word(FP_COMP0 + (i * 4), 0);
+        }
+    }
+    bp_used = 0;
+}
+
+static uint8_t flash_flush(void)
+{
+    if (!flash_dirty) {
+        return 1;
+    }
+    flash_dirty = 0;
+    flash_done = flash_base + GDB_FLASH_BLOCK;
+    return (TARGET_OK == target_flash_program_page(flash_base, flash_buf, GDB_FLASH_BLOCK));
+}
+
+// gdb sorts the load by address, so blocks are filled in order. Gaps are programmed
+//  as erased flash. A write below a block already programmed fails, there is no erase
+//  between the two
+static uint8_t flash_write(uint32_t addr, uint8_t *data, uint32_t len)
+{
+    uint32_t offset;
+
+    if (!flash_open || (addr < target_device.flash_start) || ((addr + len) > target_device.flash_end)) {
+        return 0;
+    }
+    offset = addr - target_device.flash_start;
+    if (offset < flash_done) {
+        return 0;
+    }
+    while (len--) {
+        if (flash_dirty && ((offset & ~(GDB_FLASH_BLOCK - 1)) != flash_base)) {
+            if (!flash_flush()) {
+                return 0;
+            }
+        }
+        if (!flash_dirty) {
+            memset(flash_buf, 0xff, GDB_FLASH_BLOCK);
+            flash_base = offset & ~(GDB_FLASH_BLOCK - 1);
+            flash_dirty = 1;
+        }
+        flash_buf[offset - flash_base] = *data++;
+        offset++;
+    }
+    return 1;
+}
+
+static uint8_t *put_region(uint8_t *out, const char *type, uint32_t start, uint32_t length)
+{
+    out = put_str(out, "<memory type=\"");
+    out = put_str(out, type);
+    out = put_str(out, "\" start=\"0x");
+    out = put_hex(out, start, 8);
+    out = put_str(out, "\" length=\"0x");
+    out = put_hex(out, length, 8);
+    return put_str(out, "\"");
+}
+
+// target_flash_init erases the whole chip, so the flash is one erase block. Everything
+//  else is RAM to gdb so the peripherals can be read
+static uint32_t memory_map(uint8_t *out)
+{
+    uint32_t start = target_device.flash_start, end = target_device.flash_end;
+    uint8_t *p = put_str(out, "<memory-map>");
+
+    if (start) {
+        p = put_str(put_region(p, "ram", 0, start), "/>");
+    }
+    p = put_str(put_region(p, "flash", start, end - start), "><property name=\"blocksize\">0x");
+    p = put_str(put_hex(p, end - start, 8), "</property></memory>");
+    if (end) {
+        p = put_str(put_region(p, "ram", end, 0 - end), "/>");
+    }
+    p = put_str(p, "</memory-map>");
+    return (p - out);
+}
+
+// qXfer:object:read:annex:offset,length
+static void send_xfer(const uint8_t *doc, uint32_t size, uint8_t *p)
+{
+    uint32_t offset, len;
+
+    offset = get_hex(&p);
+    if (*p++ != ',') {
+        send_str("E01");
+        return;
+    }
+    len = get_hex(&p);
+    if (len > (GDB_PACKET_SIZE - 1)) {
+        len = GDB_PACKET_SIZE - 1;
+    }
+    if (offset > size) {
+        offset = size;
+    }
+    reply[0] = 'm';
+    if (len >= (size - offset)) {
+        len = size - offset;
+        reply[0] = 'l';
+    }
+    memcpy(reply + 1, doc + offset, len);
+    send_packet(len + 1);
+}
+
+static void read_registers(void)
+{
+    uint8_t *p = reply;
+    uint32_t i, val;
+
+    for (i = 0; i < GDB_REGS; i++) {
+        if (!swd_read_core_register(i, &val)) {
+            send_error();
+            return;
+        }
+        p = put_bytes(p, (uint8_t *)&val, 4);
+    }
+    send_packet(p - reply);
+}
+
+static void write_registers(void)
+{
+    uint32_t i, val;
+
+    if ((rx_len < (1 + GDB_REGS * 8)) || !decode_hex(rx + 1, GDB_REGS * 4)) {
+        send_str("E01");
+        return;
+    }
+    for (i = 0; i < GDB_REGS; i++) {
+        memcpy(&val, rx + 1 + (i * 4), 4);
+        if (!swd_write_core_register(i, val)) {
+            send_error();
+            return;
+        }
+    }
+    send_str("OK");
+}
+
+// p n
+static void read_register(void)
+{
+    uint8_t *p = rx + 1;
+    uint32_t n = get_hex(&p), val;
+
+    if (n >= GDB_REGS) {
+        send_str("E01");
+    } else if (!swd_read_core_register(n, &val)) {
+        send_error();
+    } else {
+        send_packet(put_bytes(reply, (uint8_t *)&val, 4) - reply);
+    }
+}
+
+// P n=value
+static void write_register(void)
+{
+    uint8_t *p = rx + 1;
+    uint32_t n = get_hex(&p), val;
+
+    if ((n >= GDB_REGS) || (*p++ != '=') || ((p + 8) > (rx + rx_len)) || !decode_hex(p, 4)) {
+        send_str("E01");
+        return;
+    }
+    memcpy(&val, p, 4);
+    if (!swd_write_core_register(n, val)) {
+        send_error();
+        return;
+    }
+    send_str("OK");
+}
+
+// m addr,length
+static void read_memory(void)
+{
+    uint8_t *p = rx + 1;
+    uint32_t addr, len;
+
+    addr = get_hex(&p);
+    if (*p++ != ',') {
+        send_str("E01");
+        return;
+    }
+    len = get_hex(&p);
+    if (len > (GDB_PACKET_SIZE / 2)) {
+        len = GDB_PACKET_SIZE / 2;
+    }
+    // read into the upper half of the reply and spread it out as hex from the bottom
+    p = reply + GDB_PACKET_SIZE - len;
+    if (!swd_read_memory(addr, p, len)) {
+        send_error();
+        return;
+    }
+    send_packet(put_bytes(reply, p, len) - reply);
+}
+
+// M addr,length:hex and X addr,length:binary
+static void write_memory(uint8_t binary)
+{
+    uint8_t *p = rx + 1;
+    uint32_t addr, len, n;
+
+    addr = get_hex(&p);
+    if (*p++ != ',') {
+        send_str("E01");
+        return;
+    }
+    len = get_hex(&p);
+    if (*p++ != ':') {
+        send_str("E01");
+        return;
+    }
+    n = rx_len - (p - rx);
+    if (binary ? (unescape(p, n) != len) : ((n != (len * 2)) || !decode_hex(p, len))) {
+        send_str("E01");
+    } else if (!swd_write_memory(addr, p, len)) {
+        send_error();
+    } else {
+        send_str("OK");
+    }
+}
+
+// Z0 and Z1 both use the FPB, gdb would fall back to writing BKPT into flash otherwise
+static void breakpoint(uint8_t set)
+{
+    uint8_t *p = rx + 3;
+    uint32_t addr;
+
+    if (('0' != rx[1]) && ('1' != rx[1])) {
+        // no watchpoints
+        send_packet(0);
+        return;
+    }
+    addr = get_hex(&p);
+    if (set ? set_breakpoint(addr) : clear_breakpoint(addr)) {
+        send_str("OK");
+    } else {
+        send_error();
+    }
+}
+
+// c [addr] and s [addr]
+static void resume_command(uint8_t step)
+{
+    uint8_t *p = rx + 1;
+
+    if ((rx_len > 1) && !swd_write_core_register(15, get_hex(&p))) {
+        send_error();
+        return;
+    }
+    if (!resume(step)) {
+        send_error();
+    } else if (!running) {
+        send_stop(SIGTRAP);
+    }
+}
+
+// qRcmd,hex: "monitor reset" (the core is left halted at the reset vector) and "monitor halt"
+static void monitor_command(void)
+{
+    uint8_t *cmd = rx + 6;
+    uint32_t len = (rx_len - 6) / 2;
+    uint8_t ok = 0;
+
+    if (!decode_hex(cmd, len)) {
+        send_str("E01");
+        return;
+    }
+    cmd[len] = 0;
+    if ((0 == strcmp((const char *)cmd, "reset")) || (0 == strcmp((const char *)cmd, "reset halt"))) {
+        ok = target_set_state(RESET_PROGRAM);
+        running = 0;
+    } else if (0 == strcmp((const char *)cmd, "halt")) {
+        ok = swd_halt_target();
+        running = 0;
+    }
+    send_str(ok ? "OK" : "E01");
+}
+
+static void flash_command(void)
+{
+    uint8_t *p;
+    uint32_t addr, len;
+    uint8_t ok = 1;
+
+    if (is_cmd("vFlashErase:")) {
+        // the erase covers the whole chip whatever range is given
+        if (!flash_open) {
+            running = 0;
+            flash_dirty = 0;
+            flash_done = 0;
+            ok = flash_open = (TARGET_OK == target_flash_init(BIN));
+        }
+    } else if (is_cmd("vFlashWrite:")) {
+        p = rx + 12;
+        addr = get_hex(&p);
+        len = unescape(p + 1, rx_len - (p + 1 - rx));
+        ok = (':' == *p) && flash_write(addr, p + 1, len);
+        if (!ok) {
+            flash_open = 0;
+        }
+    } else {
+        ok = flash_open && flash_flush() && (TARGET_OK == target_flash_uninit());
+        flash_open = 0;
+        // leave the core halted at the reset vector of the new image
+        if (ok) {
+            ok = target_set_state(RESET_PROGRAM);
+        }
+    }
+    send_str(ok ? "OK" : "E01");
+}
+
+static void query_command(void)
+{
+    if (is_cmd("qSupported")) {
+        send_packet(put_str(put_hex(put_str(reply, "PacketSize="), GDB_PACKET_SIZE, 4),
+                            ";qXfer:features:read+;qXfer:memory-map:read+;QStartNoAckMode+") - reply);
+    } else if (is_cmd("qXfer:features:read:target.xml:")) {
+        send_xfer((const uint8_t *)target_xml, sizeof(target_xml) - 1, rx + 31);
+    } else if (is_cmd("qXfer:memory-map:read::")) {
+        // flash_buf is free between loads
+        if (flash_open) {
+            send_str("E01");
+        } else {
+            send_xfer(flash_buf, memory_map(flash_buf), rx + 23);
+        }
+    } else if (is_cmd("qRcmd,")) {
+        monitor_command();
+    } else if (is_cmd("qAttached")) {
+        send_str("1");
+    } else if (is_cmd("QStartNoAckMode")) {
+        send_str("OK");
+        no_ack = 1;
+    } else {
+        send_packet(0);
+    }
+}
+
+static void handle_packet(void)
+{
+    switch (rx[0]) {
+        case '?':
+            if (!swd_halt_target()) {
+                send_error();
+                break;
+            }
+            running = 0;
+            send_stop(SIGTRAP);
+            break;
+        case 'g':
+            read_registers();
+            break;
+        case 'G':
+            write_registers();
+            break;
+        case 'p':
+            read_register();
+            break;
+        case 'P':
+            write_register();
+            break;
+        case 'm':
+            read_memory();
+            break;
+        case 'M':
+            write_memory(0);
+            break;
+        case 'X':
+            write_memory(1);
+            break;
+        case 'c':
+            resume_command(0);
+            break;
+        case 's':
+            resume_command(1);
+            break;
+        case 'Z':
+            breakpoint(1);
+            break;
+        case 'z':
+            breakpoint(0);
+            break;
+        case 'H':
+            send_str("OK");
+            break;
+        case 'D':
+            clear_breakpoints();
+            resume(0);
+            running = 0;
+            send_str("OK");
+            no_ack = 0;
+            break;
+        case 'k':
+            clear_breakpoints();
+            target_set_state(RESET_RUN);
+            running = 0;
+            no_ack = 0;
+            break;
+        case 'q':
+        case 'Q':
+            query_command();
+            break;
+        case 'v':
+            if (is_cmd("vFlash")) {
+                flash_command();
+            } else {
+                send_packet(0);
+            }
+            break;
+        default:
+            send_packet(0);
+            break;
+    }
+}
+
+static void packet_received(void)
+{
+    if ((rx_len > GDB_PACKET_SIZE) || (rx_csum != rx_sum)) {
+        if (!no_ack) {
+            port_write((const uint8_t *)"-", 1);
+        }
+        return;
+    }
+    rx[rx_len] = 0;
+    // a new connection starts with acks again
+    if (is_cmd("qSupported")) {
+        no_ack = 0;
+    }
+    if (!no_ack) {
+        port_write((const uint8_t *)"+", 1);
+    }
+    handle_packet();
+}
+
+static void rx_byte(uint8_t c)
+{
+    switch (rx_state) {
+        case RX_IDLE:
+            if ('$' == c) {
+                rx_len = 0;
+                rx_sum = 0;
+                rx_state = RX_DATA;
+            } else if (GDB_INTERRUPT == c) {
+                interrupt();
+            } else if (('-' == c) && tx_len) {
+                port_write(tx, tx_len);
+            }
+            break;
+
+        case RX_DATA:
+            if ('#' == c) {
+                rx_state = RX_CSUM_HI;
+            } else if ('$' == c) {
+                rx_len = 0;
+                rx_sum = 0;
+            } else {
+                rx_sum += c;
+                if (rx_len < GDB_PACKET_SIZE) {
+                    rx[rx_len] = c;
+                }
+                rx_len++;
+            }
+            break;
+
+        case RX_CSUM_HI:
+            rx_csum = (uint8_t)(hex_val(c) << 4);
+            rx_state = RX_CSUM_LO;
+            break;
+
+        case RX_CSUM_LO:
+            rx_csum |= (uint8_t)hex_val(c);
+            rx_state = RX_IDLE;
+            packet_received();
+            break;
+
+        default:
+            rx_state = RX_IDLE;
+            break;
+    }
+}
+
+static void gdb_session(void)
+{
+    uint8_t buf[32];
+    int32_t n, i;
+
+    rx_state = RX_IDLE;
+    tx_len = 0;
+    no_ack = 0;
+    running = 0;
+    bp_count = 0;
+    flash_open = 0;
+    gdb_stop = 0;
+    // drop what was typed at the UART bridge
+    while (USBD_CDC_ACM_DataRead(buf, sizeof(buf)) > 0);
+    // held for the whole session. Waits for a FLASH.BIN read in progress
+    swd_port_take(NO_TIMEOUT);
+    if (swd_init_debug()) {
+        write_word(DBG_HCSR, DBGKEY | C_DEBUGEN);
+    }
+
+    while (!gdb_stop) {
+        n = USBD_CDC_ACM_DataRead(buf, sizeof(buf));
+        for (i = 0; (i < n) && !gdb_stop; i++) {
+            rx_byte(buf[i]);
+        }
+        poll_halt();
+        // Sleep a tick when nothing came in so the serial, semihost and idle tasks below
+        //  this priority get to run. A packet in progress is read back to back
+        if (OS_R_EVT == os_evt_wait_or(FLAGS_GDB_STOP, (n > 0) ? 0 : 1)) {
+            gdb_stop = 1;
+        }
+    }
+
+    if (flash_open) {
+        target_flash_uninit();
+        flash_open = 0;
+    }
+    clear_breakpoints();
+    swd_port_release();
+}
+
+static void gdb_main(void) {
+    while(1) {
+        // Wait for start flag
+        os_evt_wait_or(FLAGS_GDB_START, NO_TIMEOUT);
+        gdb_session();
+        // Stopped
+        os_sem_send(gdb_stopped_sem);
+    }
+}
+
+void gdb_server_init(void) {
+    // Called from main task
+
+    gdb_enabled = 0;
+    os_sem_init(gdb_stopped_sem, 0);
+
+    // Create gdb server task
+    gdb_task = os_tsk_create_user(gdb_main, GDB_TASK_PRIORITY, (void *)stk_gdb_task, GDB_TASK_STACK);
+    return;
+}
+
+uint8_t gdb_server_enable(void) {
+    // Called from cmsis-dap when the host asks for it. Not while a debugger
+    //  holds the swd port or a drag and drop is programming the target
+
+    if (gdb_enabled) return 1;
+    if (gdb_task==0) return 0;
+    if (DAP_Data.debug_port != DAP_PORT_DISABLED) return 0;
+    if (file_transfer_state.transfer_started) return 0;
+
+    // the server watches for halts itself
+    semihost_disable();
+
+    gdb_enabled = 1;
+    os_evt_set(FLAGS_GDB_START, gdb_task);
+    return 1;
+}
+
+void gdb_server_disable(void) {
+    // Called from:
+    //   - cmsis-dap when a debugger opens the swd port
+    //   - cmsis-dap when the host asks for it
+
+    if (!gdb_enabled) return;
+
+    os_evt_set(FLAGS_GDB_STOP, gdb_task);
+
+    // Wait for gdb server task to stop
+    os_sem_wait(gdb_stopped_sem, NO_TIMEOUT);
+    gdb_enabled = 0;
+    return;
+}
+
+uint8_t gdb_server_active(void) {
+    return gdb_enabled;
+}
+
+#else /* #ifndef GDB_SERVER */
+#include "gdb_server.h"
+
+void gdb_server_init(void) { }
+uint8_t gdb_server_enable(void) { return 0; }
+void gdb_server_disable(void) { }
+uint8_t gdb_server_active(void) { return 0; }
+#endif
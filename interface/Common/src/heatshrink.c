@@ -0,0 +1,201 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Streaming decoder for the heatshrink (LZSS) bitstream. Bits are read MSB first.
+//  A set tag bit is followed by an 8 bit literal. A clear tag bit is followed by
+//  a back-reference of window_bits (offset - 1) and lookahead_bits (count - 1).
+
+#include "heatshrink.h"
+#include "string.h"
+
+typedef enum hs_state_t hs_state_t;
+enum hs_state_t {
+    HS_STATE_HEADER = 0,
+    HS_STATE_TAG,
+    HS_STATE_LITERAL,
+    HS_STATE_BACKREF_INDEX,
+    HS_STATE_BACKREF_COUNT,
+    HS_STATE_YIELD_BACKREF,
+    HS_STATE_DONE
+};
+
+static struct {
+    hs_state_t state;
+    uint8_t  header[HEATSHRINK_HEADER_SIZE];
+    uint32_t header_idx;
+    uint8_t  window_bits;
+    uint8_t  lookahead_bits;
+    uint32_t image_size;    // uncompressed size from the header
+    uint32_t image_idx;     // amount of uncompressed data produced so far
+    uint32_t bit_acc;       // bits read from the input but not yet consumed
+    uint8_t  bit_cnt;
+    uint16_t backref_offset;
+    uint16_t backref_count;
+    uint16_t head;          // next write position in the window
+    uint8_t  window[1 << HEATSHRINK_MAX_WINDOW_BITS];
+} hsd;
+
+static uint32_t read_le32(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+uint8_t validate_heatshrink_header(const uint8_t *buf)
+{
+    if ((buf[0] != 'H') || (buf[1] != 'S') || (buf[2] != 'Z') || (buf[3] != HEATSHRINK_VERSION)) {
+        return 0;
+    }
+    // window must fit the decoder and the lookahead must be smaller than the window
+    if ((buf[4] < 4) || (buf[4] > HEATSHRINK_MAX_WINDOW_BITS) || (buf[5] < 3) || (buf[5] >= buf[4])) {
+        return 0;
+    }
+    if ((buf[6] != 0) || (buf[7] != 0) || (0 == read_le32(&buf[8]))) {
+        return 0;
+    }
+    return 1;
+}
+
+void reset_heatshrink_decoder(void)
+{
+    memset(&hsd, 0, sizeof(hsd));
+    hsd.state = HS_STATE_HEADER;
+}
+
+// Returns -1 when the input runs out before count bits are available. Bits already
+//  taken from the input are kept so decoding resumes cleanly on the next block.
+static int32_t get_bits(uint8_t count, const uint8_t **in, const uint8_t *in_end)
+{
+    uint32_t val;
+    while (hsd.bit_cnt < count) {
+        if (*in >= in_end) {
+            return -1;
+        }
+        hsd.bit_acc = (hsd.bit_acc << 8) | *(*in)++;
+        hsd.bit_cnt += 8;
+    }
+    hsd.bit_cnt -= count;
+    val = hsd.bit_acc >> hsd.bit_cnt;
+    hsd.bit_acc &= (1 << hsd.bit_cnt) - 1;
+    return (int32_t)val;
+}
+
+static void emit_byte(uint8_t c, uint8_t **out)
+{
+    hsd.window[hsd.head & ((1 << hsd.window_bits) - 1)] = c;
+    hsd.head++;
+    hsd.image_idx++;
+    *(*out)++ = c;
+}
+
+heatshrink_decode_status_t heatshrink_decode_blob(const uint8_t *hs_blob, const uint32_t hs_blob_size, uint32_t *hs_parse_cnt, uint8_t *bin_buf, const uint32_t bin_buf_size, uint32_t *bin_buf_cnt)
+{
+    heatshrink_decode_status_t status = HS_DECODE_OK;
+    const uint8_t *in = hs_blob;
+    const uint8_t *in_end = hs_blob + hs_blob_size;
+    uint8_t *out = bin_buf;
+    uint8_t *out_end = bin_buf + bin_buf_size;
+    int32_t bits = 0;
+
+    while (1) {
+        // the image can end part way through a block. Anything after is padding
+        if ((hsd.state != HS_STATE_HEADER) && (hsd.image_idx >= hsd.image_size)) {
+            hsd.state = HS_STATE_DONE;
+        }
+        if (HS_STATE_DONE == hsd.state) {
+            in = in_end;
+            status = HS_DECODE_EOF;
+            break;
+        }
+        if (out >= out_end) {
+            status = HS_DECODE_OUTPUT_FULL;
+            break;
+        }
+        bits = 0;
+        switch (hsd.state) {
+            case HS_STATE_HEADER:
+                while ((hsd.header_idx < HEATSHRINK_HEADER_SIZE) && (in < in_end)) {
+                    hsd.header[hsd.header_idx++] = *in++;
+                }
+                if (hsd.header_idx < HEATSHRINK_HEADER_SIZE) {
+                    bits = -1;
+                    break;
+                }
+                if (0 == validate_heatshrink_header(hsd.header)) {
+                    status = HS_DECODE_BAD_HEADER;
+                    goto decode_exit;
+                }
+                hsd.window_bits = hsd.header[4];
+                hsd.lookahead_bits = hsd.header[5];
+                hsd.image_size = read_le32(&hsd.header[8]);
+                hsd.state = HS_STATE_TAG;
+                break;
+
+            case HS_STATE_TAG:
+                bits = get_bits(1, &in, in_end);
+                if (bits >= 0) {
+                    hsd.state = (bits) ? HS_STATE_LITERAL : HS_STATE_BACKREF_INDEX;
+                }
+                break;
+
+            case HS_STATE_LITERAL:
+                bits = get_bits(8, &in, in_end);
+                if (bits >= 0) {
+                    emit_byte((uint8_t)bits, &out);
+                    hsd.state = HS_STATE_TAG;
+                }
+                break;
+
+            case HS_STATE_BACKREF_INDEX:
+                bits = get_bits(hsd.window_bits, &in, in_end);
+                if (bits >= 0) {
+                    hsd.backref_offset = bits + 1;
+                    hsd.state = HS_STATE_BACKREF_COUNT;
+                }
+                break;
+
+            case HS_STATE_BACKREF_COUNT:
+                bits = get_bits(hsd.lookahead_bits, &in, in_end);
+                if (bits >= 0) {
+                    hsd.backref_count = bits + 1;
+                    hsd.state = HS_STATE_YIELD_BACKREF;
+                }
+                break;
+
+            case HS_STATE_YIELD_BACKREF:
+                while ((hsd.backref_count > 0) && (out < out_end) && (hsd.image_idx < hsd.image_size)) {
+                    emit_byte(hsd.window[(hsd.head - hsd.backref_offset) & ((1 << hsd.window_bits) - 1)], &out);
+                    hsd.backref_count--;
+                }
+                if (0 == hsd.backref_count) {
+                    hsd.state = HS_STATE_TAG;
+                }
+                break;
+
+            default:
+                status = HS_DECODE_FAILURE;
+                goto decode_exit;
+        }
+        // input exhausted. Partial bit fields are held until the next block arrives
+        if (bits < 0) {
+            break;
+        }
+    }
+
+decode_exit:
+    *hs_parse_cnt = in - hs_blob;
+    *bin_buf_cnt = out - bin_buf;
+    return status;
+}
@@ -49,13 +49,45 @@ static uint16_t swap16(uint16_t a)
     return ((a & 0x00ff) << 8) | ((a & 0xff00) >> 8);
 }
 
+/** Value of each ascii character as a hex digit. 0xff marks characters
+ *   that are not hex digits so a lookup also validates the input
+ */
+static const uint8_t hex_digit[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
 /** Converts a character representation of a hex to real value.
  *   @param c is the hex value in char format
  *   @return the value of the hex
  */
 static uint8_t ctoh(char c)
 {
-    return (c & 0x10) ? /*0-9*/ c & 0xf : /*A-F, a-f*/ (c & 0xf) + 9;
+    return hex_digit[(uint8_t)c] & 0xf;
+}
+
+/** Converts two ascii hex digits into a byte
+ *   @param c points to the most significant digit
+ *   @return the value 0-0xff or -1 if either character isnt a hex digit
+ */
+static int32_t decode_byte(const uint8_t *c)
+{
+    uint8_t hi = hex_digit[c[0]], lo = hex_digit[c[1]];
+    return ((hi | lo) & 0xf0) ? -1 : (int32_t)((hi << 4) | lo);
 }
 
 /** Calculate checksum on a hex record
@@ -87,6 +119,72 @@ void reset_hex_parser(void)
     load_unaligned_record = 0;
 }
 
+uint8_t validate_hex_records(const uint8_t *hex_blob, const uint32_t hex_blob_size, const uint32_t records)
+{
+    uint32_t i = 0, n = 0, len = 0, j = 0;
+    int32_t val = 0;
+    uint8_t sum = 0, byte_count = 0, record_type = 0;
+
+    while (n < records) {
+        // records may be separated by any line ending
+        while ((i < hex_blob_size) && ((hex_blob[i] == '\r') || (hex_blob[i] == '\n'))) {
+            i++;
+        }
+        if ((i + 9) > hex_blob_size) {
+            break;
+        }
+        if (hex_blob[i] != ':') {
+            return 0;
+        }
+        val = decode_byte(&hex_blob[i+1]);
+        // longer records would overrun the line buffer of the parser
+        if ((val < 0) || ((uint32_t)val > sizeof(line.data))) {
+            return 0;
+        }
+        byte_count = (uint8_t)val;
+        len = 1 + ((byte_count + 5) * 2);
+        // a record cut off by the end of the buffer cant be judged
+        if ((i + len) > hex_blob_size) {
+            break;
+        }
+        sum = 0;
+        for (j = 0; j < (uint32_t)(byte_count + 5); j++) {
+            val = decode_byte(&hex_blob[i + 1 + (j * 2)]);
+            if (val < 0) {
+                return 0;
+            }
+            sum += (uint8_t)val;
+        }
+        if (sum != 0) {
+            return 0;
+        }
+        record_type = (uint8_t)decode_byte(&hex_blob[i+7]);
+        switch (record_type) {
+            case DATA_RECORD:
+                break;
+            case EOF_RECORD:
+                return (0 == byte_count) ? 1 : 0;
+            case EXT_SEG_ADDR_RECORD:
+            case EXT_LINEAR_ADDR_RECORD:
+                if (2 != byte_count) {
+                    return 0;
+                }
+                break;
+            case START_SEG_ADDR_RECORD:
+            case START_LINEAR_ADDR_RECORD:
+                if (4 != byte_count) {
+                    return 0;
+                }
+                break;
+            default:
+                return 0;
+        }
+        n++;
+        i += len;
+    }
+    return (n > 0) ? 1 : 0;
+}
+
 hexfile_parse_status_t parse_hex_blob(const uint8_t *hex_blob, const uint32_t hex_blob_size, uint32_t *hex_parse_cnt, uint8_t *bin_buf, const uint32_t bin_buf_size, uint32_t *bin_buf_address, uint32_t *bin_buf_cnt)
 {
     uint8_t *end = (uint8_t *)hex_blob + hex_blob_size;
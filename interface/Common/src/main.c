@@ -23,6 +23,7 @@
 #include "gpio.h"
 #include "uart.h"
 #include "semihost.h"
+#include "gdb_server.h"
 #include "serial.h"
 #include "tasks.h"
 #include "target_reset.h"
@@ -204,6 +205,11 @@ __task void serial_process()
             }
         }
 
+        // The gdb server has the virtual COM port
+        if (gdb_server_active()) {
+            continue;
+        }
+
         len_data = USBD_CDC_ACM_DataFree();
         if (len_data > SIZE_DATA) {
             len_data = SIZE_DATA;
@@ -266,6 +272,9 @@ __task void main_task(void)
     gpio_enable_button_flag(main_task_id, FLAGS_MAIN_RESET);
     button_activated = 1;
     
+    // debug port ownership, before the tasks that share the port start
+    swd_port_init();
+
     // do some init with the target before USB and files are configured
     prerun_target_config();
     
@@ -284,6 +293,9 @@ __task void main_task(void)
     semihost_init();
     semihost_enable();
 
+    // gdb server task, started by the host
+    gdb_server_init();
+
     // Start timer tasks
     os_tsk_create_user(timer_task_30mS, TIMER_TASK_30_PRIORITY, (void *)stk_timer_30_task, TIMER_TASK_30_STACK);
     
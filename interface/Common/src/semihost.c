@@ -223,8 +223,28 @@ void semihost_disable(void) {
     return;
 }
 
+// Stop polling around a short probe-side access from another task, without
+// the debug state changes of semihost_disable/semihost_enable
+uint8_t semihost_pause(void) {
+    if (!semihostEnabled) return 0;
+    semihost_disable();
+    return 1;
+}
+
+void semihost_resume(void) {
+    if (semihostEnabled) return;
+    if (semihostTask==0) return;
+
+    os_evt_set(FLAGS_SH_START, semihostTask);
+    semihostEnabled = 1;
+}
+
 #else /* #ifndef SEMIHOST */
+#include "semihost.h"
+
 void semihost_init(void) { }
 void semihost_enable(void) { }
 void semihost_disable(void){ }
+uint8_t semihost_pause(void) { return 0; }
+void semihost_resume(void) { }
 #endif
@@ -23,6 +23,7 @@
 #include "debug_cm.h"
 #include "DAP_config.h"
 #include "DAP.h"
+#include "dap_telemetry.h"
 
 // Default NVIC and Core debug base addresses
 // TODO: Read these addresses from ROM.
@@ -80,9 +81,6 @@ typedef struct {
 
 static DAP_STATE dap_state;
 
-static uint8_t swd_read_core_register(uint32_t n, uint32_t *val);
-static uint8_t swd_write_core_register(uint32_t n, uint32_t val);
-
 static void int2array(uint8_t * res, uint32_t data, uint8_t len) {
     uint8_t i = 0;
     for (i = 0; i < len; i++) {
@@ -99,10 +97,27 @@ static uint8_t swd_transfer_retry(uint32_t req, uint32_t * data) {
             return ack;
         }
     }
+    telemetry_end(ack, 0);
     return ack;
 }
 
 
+static OS_MUT swd_port_mutex;
+
+// Called from the main task before the tasks that use the port are created
+void swd_port_init(void) {
+    os_mut_init(swd_port_mutex);
+}
+
+// Wait up to timeout ticks for the port, NO_TIMEOUT to wait until it is free
+uint8_t swd_port_take(uint16_t timeout) {
+    return (OS_R_TMO != os_mut_wait(swd_port_mutex, timeout));
+}
+
+void swd_port_release(void) {
+    os_mut_release(swd_port_mutex);
+}
+
 uint8_t swd_init(void) {
     DAP_Setup();
     PORT_SWD_SETUP();
@@ -467,13 +482,21 @@ uint8_t swd_write_memory(uint32_t address, uint8_t *data, uint32_t size) {
         size--;
     }
     // Write word aligned blocks
-    n = size & 0xfffffffc;
-    if (!swd_write_block(address, data, n)) {
-        return 0;
+    while (size > 3) {
+        // Limit to auto increment page size
+        n = TARGET_AUTO_INCREMENT_PAGE_SIZE - (address & (TARGET_AUTO_INCREMENT_PAGE_SIZE - 1));
+        if (size < n) {
+            n = size & 0xfffffffc; // Only count complete words remaining
+        }
+
+        if (!swd_write_block(address, data, n)) {
+            return 0;
+        }
+
+        address += n;
+        data += n;
+        size -= n;
     }
-    address += n;
-    data += n;
-    size -= n;
 
     // Write remaining bytes
     while (size > 0) {
@@ -520,10 +543,6 @@ static uint8_t swd_write_debug_state(DEBUG_STATE *state) {
         return 0;
     }
     
-    if (!swd_write_block(flash.algo_start, (uint8_t *)flash.image, flash.algo_size)){
-        return 0;
-    }
-
     if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN)) {
         return 0;
     }
@@ -540,7 +559,7 @@ static uint8_t swd_write_debug_state(DEBUG_STATE *state) {
     return 1;
 }
 
-static uint8_t swd_read_core_register(uint32_t n, uint32_t *val) {
+uint8_t swd_read_core_register(uint32_t n, uint32_t *val) {
     int i = 0, timeout = 100;
     if (!swd_write_word(DCRSR, n)) {
         return 0;
@@ -569,7 +588,7 @@ static uint8_t swd_read_core_register(uint32_t n, uint32_t *val) {
     return 1;
 }
 
-static uint8_t swd_write_core_register(uint32_t n, uint32_t val) {
+uint8_t swd_write_core_register(uint32_t n, uint32_t val) {
     int i = 0, timeout = 100;
     if (!swd_write_word(DCRDR, val))
         return 0;
@@ -661,6 +680,27 @@ uint8_t swd_semihost_restart(uint32_t r0) {
 }
 
 uint8_t swd_flash_syscall_exec(const FLASH_SYSCALL *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    uint32_t result;
+
+    if (!swd_syscall_exec(sysCallParam, entry, arg1, arg2, arg3, arg4, &result)) {
+        return 0;
+    }
+
+    // Flash functions return 0 if successful.
+    return (result == 0);
+}
+
+// Halt the core so its registers can be set up for a call
+uint8_t swd_halt_target(void) {
+    if (!swd_write_word(DBG_HCSR, DBGKEY | C_DEBUGEN | C_HALT)) {
+        return 0;
+    }
+
+    return swd_wait_until_halted();
+}
+
+// Call a routine in target RAM and return its R0. The core must be halted
+uint8_t swd_syscall_exec(const FLASH_SYSCALL *sysCallParam, uint32_t entry, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t *result) {
     DEBUG_STATE state = {{0},0};
     // Call flash algorithm function on target and wait for result.
     state.r[0]     = arg1;                   // R0: Argument 1
@@ -683,12 +723,7 @@ uint8_t swd_flash_syscall_exec(const FLASH_SYSCALL *sysCallParam, uint32_t entry
         return 0;
     }
 
-    if (!swd_read_core_register(0, &state.r[0])) {
-        return 0;
-    }
-
-    // Flash functions return 0 if successful.
-    if (state.r[0] != 0) {
+    if (!swd_read_core_register(0, result)) {
         return 0;
     }
 
@@ -761,16 +796,17 @@ static uint8_t JTAG2SWD() {
     return 1;
 }
 
-uint8_t swd_init_debug(void) {
-    uint32_t tmp = 0;
-    // init dap state with fake values
+// Forget the cached SELECT and CSW values. Needed when the host has
+// accessed the debug port directly with DAP_Transfer.
+void swd_invalidate_state(void) {
     dap_state.select = 0xffffffff;
     dap_state.csw = 0xffffffff;
-    swd_init();
-    // call a target dependant function
-    // this function can do several stuff before really
-    // initing the debug
-    target_before_init_debug();
+}
+
+// Switch the port to SWD, clear the sticky errors and power up the debug and
+// system domains. A target that never acks the power up fails after MAX_TIMEOUT reads
+static uint8_t swd_power_up(void) {
+    uint32_t tmp = 0, timeout = MAX_TIMEOUT;
 
     if (!JTAG2SWD()) {
         return 0;
@@ -794,7 +830,26 @@ uint8_t swd_init_debug(void) {
         if (!swd_read_dp(DP_CTRL_STAT, &tmp)) {
             return 0;
         }
-    } while ((tmp & (CDBGPWRUPACK | CSYSPWRUPACK)) != (CDBGPWRUPACK | CSYSPWRUPACK));
+        if ((tmp & (CDBGPWRUPACK | CSYSPWRUPACK)) == (CDBGPWRUPACK | CSYSPWRUPACK)) {
+            return 1;
+        }
+    } while (--timeout);
+
+    return 0;
+}
+
+uint8_t swd_init_debug(void) {
+    // init dap state with fake values
+    swd_invalidate_state();
+    swd_init();
+    // call a target dependant function
+    // this function can do several stuff before really
+    // initing the debug
+    target_before_init_debug();
+
+    if (!swd_power_up()) {
+        return 0;
+    }
 
     if (!swd_write_dp(DP_CTRL_STAT, CSYSPWRUPREQ | CDBGPWRUPREQ | TRNNORMAL | MASKLANE)) {
         return 0;
@@ -812,6 +867,16 @@ uint8_t swd_init_debug(void) {
     return 1;
 }
 
+// Bring up the debug port of a running target for memory reads only.
+// Unlike swd_init_debug() and target_set_state(DEBUG) the target hooks are
+// not called and DHCSR is left alone, so a halted core stays halted and a
+// running one is not put in debug state.
+uint8_t swd_attach(void) {
+    swd_invalidate_state();
+    swd_init();
+    return swd_power_up();
+}
+
 
 void swd_set_target_reset(uint8_t asserted) {
     if (asserted) {
@@ -21,14 +21,47 @@
 #include "target_config.h"
 #include "flash_blob.h"
 #include "intelhex.h"
+#include "heatshrink.h"
+#include "crc.h"
+#include "program_profile.h"
 #include "string.h"
 
+// Read back every page right after it is programmed and compare against the CRC of
+//  the data that was sent to the target. It runs in series with programming and
+//  costs about as much as the data transfer, so define as 1 in target_config.h to use
+#ifndef TARGET_FLASH_VERIFY
+#define TARGET_FLASH_VERIFY (0)
+#endif
+
+// Size of the Cortex-M core exception part of the vector table checked in a bin file
+#define BIN_NVIC_SIZE (64)
+
+// Number of records at the start of a hex file that must decode cleanly before it is
+//  programmed. They are taken from the first MSC block (512 bytes)
+#ifndef HEX_VALIDATE_RECORDS
+#define HEX_VALIDATE_RECORDS (4)
+#endif
+#define HEX_VALIDATE_SIZE (512)
+
+// Largest region target_flash_crc() hands to one call so it ends within the syscall timeout
+#define CRC_CALL_SIZE (0x4000)
+
 //static target_flash_status_t target_flash_erase_chip(void);
 //static target_flash_status_t target_flash_erase_sector(uint32_t adr);
 static target_flash_status_t program_hex(uint8_t *buf, uint32_t size);
 static target_flash_status_t program_bin(uint32_t addr, uint8_t *buf, uint32_t size);
+static target_flash_status_t program_hsz(uint8_t *buf, uint32_t size);
+static target_flash_status_t program_bin_batch(uint32_t addr, uint8_t *buf, uint32_t size);
+static target_flash_status_t flush_bin_batch(void);
+static uint32_t program_batch_size(void);
 static void set_hex_state_vars(void);
 static extension_t file_extension;
+static uint32_t hsz_image_idx = 0;  // amount of decompressed data sent to target RAM
+static uint32_t page_crc = 0;       // CRC of the data in the target RAM page waiting to be programmed
+static uint32_t algo_crc = 0;       // CRC of the code part of flash.image, computed on first use
+static uint32_t algo_resident_crc = 0;  // CRC of the algorithm last downloaded to target RAM, 0 if unknown
+static uint32_t batch_addr = 0;     // flash offset of the bin data waiting in target RAM
+static uint32_t batch_cnt = 0;      // amount of bin data waiting in target RAM for a program_pages call
 
 static /*inline*/ uint32_t test_range(const uint32_t test, const uint32_t min, const uint32_t max)
 {
@@ -37,23 +70,30 @@ static /*inline*/ uint32_t test_range(const uint32_t test, const uint32_t min, c
 
 uint8_t validate_bin_nvic(uint8_t *buf)
 {
-    // test for known required NVIC entries
+    // test the core exception entries of the vector table
     //  00 is stack pointer (RAM address)
     //  04 is Reset vector  (FLASH address)
     //  08 NMI_Handler      (FLASH address)
     //  12 HardFault_Handler(FLASH address)
+    //  16-24, 44-48 and 56-60 are optional handlers (FLASH address or 0)
+    //  28-40 and 52 are reserved. Some vendors keep a checksum in 28 so these arent tested
     uint32_t i = 4, nvic_val = 0;
     // test the initial SP value
     memcpy(&nvic_val, buf+0, sizeof(nvic_val));
-    if (0 == test_range(nvic_val, target_device.ram_start, target_device.ram_end)) {
+    if ((nvic_val & 0x3) || (0 == test_range(nvic_val, target_device.ram_start, target_device.ram_end))) {
         return 0;
     }
-    // Reset_Handler
-    // NMI_Handler
-    // HardFault_Handler
-    for ( ; i <=12; i+=4) {
+    for ( ; i < BIN_NVIC_SIZE; i+=4) {
+        if (((i >= 28) && (i <= 40)) || (52 == i)) {
+            continue;
+        }
         memcpy(&nvic_val, buf+i, sizeof(nvic_val));
-        if (0 == test_range(nvic_val, target_device.flash_start, target_device.flash_end)) {
+        // optional handlers may be left unpopulated
+        if ((i > 12) && (0 == nvic_val)) {
+            continue;
+        }
+        // handlers are thumb code in the target flash
+        if ((0 == (nvic_val & 0x1)) || (0 == test_range(nvic_val, target_device.flash_start, target_device.flash_end))) {
             return 0;
         }
     }
@@ -63,36 +103,165 @@ uint8_t validate_bin_nvic(uint8_t *buf)
 
 uint8_t validate_hexfile(uint8_t *buf)
 {
-    // look here for known hex records
-    // add hex identifier b[0] == ':' && b[8] == {'0', '2', '3', '4', '5'}
-    return ((buf[0] == ':') && ((buf[8] == '0') || (buf[8] == '2') || (buf[8] == '3') || (buf[8] == '4') || (buf[8] == '5'))) ? 1 : 0;
+    // decode and checksum the first records so a file that will fail to parse
+    //  is rejected before the chip is erased
+    return validate_hex_records(buf, HEX_VALIDATE_SIZE, HEX_VALIDATE_RECORDS);
+}
+
+uint8_t validate_compressed_image(uint8_t *buf)
+{
+    // container header followed by a heatshrink stream. See tools/hs_pack.py
+    return validate_heatshrink_header(buf);
+}
+
+// Page data written to the target RAM buffer, timed for the transfer profile
+static uint8_t write_program_buffer(uint32_t offset, uint8_t *buf, uint32_t size)
+{
+    uint32_t start = profile_time_us();
+    uint8_t ret = swd_write_memory(flash.program_buffer + offset, buf, size);
+    profile_phase(PROFILE_DATA, start);
+    return ret;
+}
+
+// Program size bytes of the RAM buffer at addr with a ProgramPage(s) entry, timed for the profile
+static uint8_t program_syscall(uint32_t entry, uint32_t addr, uint32_t size)
+{
+    uint32_t start = profile_time_us();
+    uint8_t ret = swd_flash_syscall_exec(&flash.sys_call_param, entry, addr + target_device.flash_start, size, flash.program_buffer, 0);
+    profile_program(start, size / flash.ram_to_flash_bytes_to_be_written);
+    return ret;
+}
+
+// CRC-32 of the crc32() in crc.c, run by the target core from target_flash_scratch() RAM.
+//  BKPT at +0, entry at +4: r0 address, r1 size, r2 crc so far. Returns the crc in r0.
+//  Byte loop over a 16 entry nibble table, Thumb-1 so any Cortex-M runs it
+static const uint32_t crc_blob[] = {
+    0xE7FEBE00, 0xA30A43D2, 0xD00E2900, 0x30017804, 0x07144062, 0x591C0EA4, 0x40620912, 0x0EA40714,
+    0x0912591C, 0x39014062, 0x43D0D1F0, 0x46C04770, 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+uint8_t target_flash_crc(uint32_t addr, uint32_t size, uint32_t *value)
+{
+    FLASH_SYSCALL call;
+    uint32_t base = 0, n = 0, i = 0;
+    uint32_t check[4];
+    
+    if (!target_flash_scratch(&base, &call.stack_pointer)) {
+        return 0;
+    }
+    call.breakpoint = base + 1;
+    call.static_base = 0;
+    if (!swd_halt_target()) {
+        return 0;
+    }
+    // RAM that is missing or locked would leave the core running garbage
+    if (!swd_write_memory(base, (uint8_t *)crc_blob, sizeof(crc_blob))) {
+        return 0;
+    }
+    for (i = 0; i < sizeof(crc_blob); i += sizeof(check)) {
+        if (!swd_read_memory(base + i, (uint8_t *)check, sizeof(check)) ||
+                (0 != memcmp(check, (uint8_t *)crc_blob + i, sizeof(check)))) {
+            return 0;
+        }
+    }
+    // several calls so each one ends well within the syscall timeout
+    while (size > 0) {
+        n = (size > CRC_CALL_SIZE) ? CRC_CALL_SIZE : size;
+        if (!swd_syscall_exec(&call, base + 5, addr, n, *value, 0, value)) {
+            return 0;
+        }
+        addr += n;
+        size -= n;
+    }
+    return 1;
+}
+
+// Size of the code part of the algorithm. The rest is its static data, which it changes
+static uint32_t flash_algo_code_size(void)
+{
+    if ((flash.sys_call_param.static_base > flash.algo_start) && ((flash.sys_call_param.static_base - flash.algo_start) < flash.algo_size)) {
+        return flash.sys_call_param.static_base - flash.algo_start;
+    }
+    return flash.algo_size;
+}
+
+static uint8_t flash_algo_resident(void)
+{
+    uint32_t crc = 0;
+    
+    if (algo_resident_crc != algo_crc) {
+        return 0;
+    }
+    // a power cycle or an application reusing any of the RAM wont match. The CRC runs
+    //  on the target, much faster than reading the code back
+    if (0 == target_flash_crc(flash.algo_start, flash_algo_code_size(), &crc)) {
+        return 0;
+    }
+    return (crc == algo_crc);
 }
 
 target_flash_status_t target_flash_init(extension_t ext)
 {
+    uint32_t start = profile_time_us();
+    target_flash_status_t status = TARGET_OK;
+    
     if (0 == target_set_state(RESET_PROGRAM)) {
         return TARGET_FAIL_RESET;
     }
+    profile_phase(PROFILE_RESET, start);
     
-    // Download flash programming algorithm to target and initialise.
-    if (0 == swd_write_memory(flash.algo_start, (uint8_t *)flash.image, flash.algo_size)) {
-        return TARGET_FAIL_ALGO_DL;
+    // Download flash programming algorithm to target and initialise. Back to back
+    //  programming of the same board finds it still in RAM and skips the download
+    start = profile_time_us();
+    if (0 == algo_crc) {
+        algo_crc = crc32(0, (uint8_t *)flash.image, flash_algo_code_size());
+    }
+    if (0 == flash_algo_resident()) {
+        algo_resident_crc = 0;
+        if (0 == swd_write_memory(flash.algo_start, (uint8_t *)flash.image, flash.algo_size)) {
+            return TARGET_FAIL_ALGO_DL;
+        }
+        algo_resident_crc = algo_crc;
+    } else if (flash_algo_code_size() < flash.algo_size) {
+        // the static data is left as the last run changed it, start from the image again
+        if (0 == swd_write_memory(flash.sys_call_param.static_base, (uint8_t *)flash.image + flash_algo_code_size(), flash.algo_size - flash_algo_code_size())) {
+            algo_resident_crc = 0;
+            return TARGET_FAIL_ALGO_DL;
+        }
     }
 
     if (0 == swd_flash_syscall_exec(&flash.sys_call_param, flash.init, target_device.flash_start, 0 /* clk value is not used */, 0, 0)) {
+        algo_resident_crc = 0;
         return TARGET_FAIL_INIT;
     }
+    profile_phase(PROFILE_ALGO, start);
     
     file_extension = ext;
+    page_crc = 0;
+    batch_cnt = 0;
     if (HEX == file_extension) {
         reset_hex_parser();
         set_hex_state_vars();
     }
-    return target_flash_erase_chip();
+    else if (HSZ == file_extension) {
+        reset_heatshrink_decoder();
+        set_hex_state_vars();
+        hsz_image_idx = 0;
+    }
+    start = profile_time_us();
+    status = target_flash_erase_chip();
+    profile_phase(PROFILE_ERASE, start);
+    return status;
 }
 
 target_flash_status_t target_flash_uninit(void)
 {
+    // program whatever is still waiting in target RAM
+    if (BIN == file_extension) {
+        return flush_bin_batch();
+    }
     // when programming is complete the target should be put and held in reset
     return TARGET_OK;
 }
@@ -105,6 +274,9 @@ target_flash_status_t target_flash_program_page(uint32_t addr, uint8_t * buf, ui
     else if (BIN == file_extension) {
         return program_bin(addr, buf, size);
     }
+    else if (HSZ == file_extension) {
+        return program_hsz(buf, size);
+    }
     return TARGET_FAIL_UNKNOWN_APP_FORMAT;
 }
 
@@ -119,13 +291,60 @@ target_flash_status_t target_flash_program_page(uint32_t addr, uint8_t * buf, ui
 target_flash_status_t target_flash_erase_chip(void)
 {
     if (0 == swd_flash_syscall_exec(&flash.sys_call_param, flash.erase_chip, 0, 0, 0, 0)) {
+        algo_resident_crc = 0;
         return TARGET_FAIL_ERASE_ALL;
     }
     return TARGET_OK;
 }
 
+uint8_t target_flash_scratch(uint32_t *buffer, uint32_t *stack)
+{
+    // the program buffer and the algorithm stack are free between programming runs
+    *buffer = flash.program_buffer;
+    *stack = flash.sys_call_param.stack_pointer;
+    return (0 != *buffer);
+}
+
+// CRC of programmed data for verify_page(). Not computed when there is no verify
+static __inline uint32_t page_crc32(uint32_t crc, const uint8_t *buf, uint32_t size)
+{
+#if (TARGET_FLASH_VERIFY == 1)
+    return crc32(crc, buf, size);
+#else
+    return 0;
+#endif
+}
+
+static target_flash_status_t verify_page(uint32_t addr, uint32_t size, uint32_t expected_crc)
+{
+#if (TARGET_FLASH_VERIFY == 1)
+    static uint8_t verify_buffer[256];
+    uint32_t crc = 0, amt = 0, start = profile_time_us();
+    
+    while (size > 0) {
+        amt = (size > sizeof(verify_buffer)) ? sizeof(verify_buffer) : size;
+        if (0 == swd_read_memory(addr, verify_buffer, amt)) {
+            return TARGET_FAIL_VERIFY;
+        }
+        crc = crc32(crc, verify_buffer, amt);
+        addr += amt;
+        size -= amt;
+    }
+    profile_phase(PROFILE_VERIFY, start);
+    return (crc == expected_crc) ? TARGET_OK : TARGET_FAIL_VERIFY;
+#else
+    return TARGET_OK;
+#endif
+}
+
 static target_flash_status_t program_bin(uint32_t addr, uint8_t *buf, uint32_t size)
 {
+    target_flash_status_t status = TARGET_OK;
+
+    // the algo can program more than one page per call. Gather data in target RAM first
+    if (program_batch_size() > 0) {
+        return program_bin_batch(addr, buf, size);
+    }
     // called from msc logic so assumed that the smallest size is 512 (size of sector)
     //  flash algo must support this as minimum size.
     //  ToDO: akward requirement. look at flash algo flexibility in flash write sizes
@@ -141,20 +360,21 @@ static target_flash_status_t program_bin(uint32_t addr, uint8_t *buf, uint32_t s
 //            }
 //        }
         // Write a page in target RAM to be programmed.
-        if (0 == swd_write_memory(flash.program_buffer, buf, size)) {
+        if (0 == write_program_buffer(0, buf, flash.ram_to_flash_bytes_to_be_written)) {
             return TARGET_FAIL_ALGO_DATA_SEQ;
         }
         // Exectue a program flash sequence on the target device
-        if (0 == swd_flash_syscall_exec(
-            & flash.sys_call_param
-            , flash.program_page
-            , addr + target_device.flash_start
-            , flash.ram_to_flash_bytes_to_be_written
-            , flash.program_buffer
-            , 0)
-            ) {
+        if (0 == program_syscall(flash.program_page, addr, flash.ram_to_flash_bytes_to_be_written)) {
+            algo_resident_crc = 0;
             return TARGET_FAIL_WRITE;
         }
+        status = verify_page(addr + target_device.flash_start, flash.ram_to_flash_bytes_to_be_written, 
+                             page_crc32(0, buf, flash.ram_to_flash_bytes_to_be_written));
+        if (TARGET_OK != status) {
+            return status;
+        }
+        addr += flash.ram_to_flash_bytes_to_be_written;
+        buf += flash.ram_to_flash_bytes_to_be_written;
         size -= flash.ram_to_flash_bytes_to_be_written;
     }
     return TARGET_OK;
@@ -181,6 +401,84 @@ static const uint8_t ff_buffer[512] = {
 static uint8_t bin_buffer[256] = {0};
 static volatile uint32_t target_ram_idx = 0;         // running count of amount of data in target RAM
 
+static uint32_t program_batch_size(void)
+{
+    // whole pages of the target RAM that one program_pages call can be given
+    if ((0 == flash.program_pages) || (0 == flash.ram_to_flash_bytes_to_be_written)) {
+        return 0;
+    }
+    return (flash.max_program_size / flash.ram_to_flash_bytes_to_be_written) * flash.ram_to_flash_bytes_to_be_written;
+}
+
+static target_flash_status_t flush_bin_batch(void)
+{
+    uint32_t size = batch_cnt, pad = 0, amt = 0;
+    target_flash_status_t status = TARGET_OK;
+
+    if (0 == batch_cnt) {
+        return TARGET_OK;
+    }
+    // the end of the image can leave a partial page. Fill it as erased flash
+    pad = (flash.ram_to_flash_bytes_to_be_written - (size % flash.ram_to_flash_bytes_to_be_written)) % flash.ram_to_flash_bytes_to_be_written;
+    while (pad > 0) {
+        amt = (pad > sizeof(ff_buffer)) ? sizeof(ff_buffer) : pad;
+        if (0 == write_program_buffer(size, (uint8_t *)ff_buffer, amt)) {
+            return TARGET_FAIL_ALGO_DATA_SEQ;
+        }
+        page_crc = page_crc32(page_crc, ff_buffer, amt);
+        size += amt;
+        pad -= amt;
+    }
+    batch_cnt = 0;
+    if (0 == program_syscall(flash.program_pages, batch_addr, size)) {
+        algo_resident_crc = 0;
+        return TARGET_FAIL_WRITE;
+    }
+    status = verify_page(batch_addr + target_device.flash_start, size, page_crc);
+    page_crc = 0;
+    return status;
+}
+
+static target_flash_status_t program_bin_batch(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    uint32_t batch_size = program_batch_size(), amt = 0;
+    target_flash_status_t status = TARGET_OK;
+
+    if (1 == security_bits_set(addr, buf, size)) {
+        return TARGET_FAIL_SECURITY_BITS;
+    }
+    // data that doesnt follow on from what is waiting can't share the call
+    if ((batch_cnt > 0) && (addr != (batch_addr + batch_cnt))) {
+        status = flush_bin_batch();
+        if (TARGET_OK != status) {
+            return status;
+        }
+    }
+    while (size > 0) {
+        if (0 == batch_cnt) {
+            batch_addr = addr;
+            page_crc = 0;
+        }
+        amt = ((batch_size - batch_cnt) > size) ? size : (batch_size - batch_cnt);
+        if (0 == write_program_buffer(batch_cnt, buf, amt)) {
+            return TARGET_FAIL_ALGO_DATA_SEQ;
+        }
+        page_crc = page_crc32(page_crc, buf, amt);
+        batch_cnt += amt;
+        addr += amt;
+        buf += amt;
+        size -= amt;
+        // target RAM is full. Program all of it in one call
+        if (batch_cnt >= batch_size) {
+            status = flush_bin_batch();
+            if (TARGET_OK != status) {
+                return status;
+            }
+        }
+    }
+    return TARGET_OK;
+}
+
 static void set_hex_state_vars(void)
 {
     memset(bin_buffer, 0, sizeof(bin_buffer));
@@ -192,6 +490,9 @@ static target_flash_status_t flexible_program_block(uint32_t addr, uint8_t *buf,
 {
     // store the block start address if aligned with the programming size
     uint32_t target_flash_address = (addr / flash.ram_to_flash_bytes_to_be_written) * flash.ram_to_flash_bytes_to_be_written;
+    // amount of buf that lands in the page being filled, the rest starts the next page
+    uint32_t page_fill = ((target_ram_idx + size) > flash.ram_to_flash_bytes_to_be_written) ? (flash.ram_to_flash_bytes_to_be_written - target_ram_idx) : size;
+    target_flash_status_t status = TARGET_OK;
     // check if security bits were set. Could be an odd alignment boundry that breaks (bin_buf only has part of security region)
     if (1 == security_bits_set(target_flash_address, buf, size)) {
         return TARGET_FAIL_SECURITY_BITS;
@@ -203,27 +504,27 @@ static target_flash_status_t flexible_program_block(uint32_t addr, uint8_t *buf,
 //        }
 //    }
     // write to target RAM
-    if (0 == swd_write_memory(flash.program_buffer+target_ram_idx, buf, size)) {
+    if (0 == write_program_buffer(target_ram_idx, buf, size)) {
         return TARGET_FAIL_ALGO_DATA_SEQ;
     }
     target_ram_idx += size;
+    page_crc = page_crc32(page_crc, buf, page_fill);
     // program a block if necessary
     if (target_ram_idx >= flash.ram_to_flash_bytes_to_be_written) {
-        if (0 == swd_flash_syscall_exec(
-            & flash.sys_call_param
-            , flash.program_page
-            , target_flash_address + target_device.flash_start
-            , flash.ram_to_flash_bytes_to_be_written
-            , flash.program_buffer
-            , 0)
-            ) {
+        if (0 == program_syscall(flash.program_page, target_flash_address, flash.ram_to_flash_bytes_to_be_written)) {
+            algo_resident_crc = 0;
             return TARGET_FAIL_WRITE;
         }
+        status = verify_page(target_flash_address + target_device.flash_start, flash.ram_to_flash_bytes_to_be_written, page_crc);
+        if (TARGET_OK != status) {
+            return status;
+        }
+        page_crc = page_crc32(0, buf + page_fill, size - page_fill);
         target_ram_idx -= flash.ram_to_flash_bytes_to_be_written;
         // cleanup
         if (target_ram_idx > 0) {
             // write excess data to target RAM at bottom of buffer. This re-aligns offsets that may occur based on hex formatting
-            if (0 == swd_write_memory(flash.program_buffer, buf+(size-target_ram_idx), target_ram_idx)) {
+            if (0 == write_program_buffer(0, buf+(size-target_ram_idx), target_ram_idx)) {
                 return TARGET_FAIL_ALGO_DATA_SEQ;
             }
         }
@@ -237,6 +538,7 @@ static target_flash_status_t program_hex(uint8_t *buf, uint32_t size)
     uint32_t bin_start_address = 0; // Decoded from the hex file, the binary buffer data starts at this address
     uint32_t bin_buf_written = 0;   // The amount of data in the binary buffer starting at address above
     uint32_t block_amt_parsed = 0;  // amount of data parsed in the block on the last call
+    target_flash_status_t flash_status = TARGET_OK;
     
     while (1) {
         // try to decode a block of hex data into bin data
@@ -249,7 +551,10 @@ static target_flash_status_t program_hex(uint8_t *buf, uint32_t size)
             }
             // hex file data decoded. Write to target RAM and program if necessary
             if ( (bin_start_address % flash.ram_to_flash_bytes_to_be_written) > target_ram_idx ) {
-                flexible_program_block(bin_start_address, (uint8_t *)ff_buffer, (bin_start_address % flash.ram_to_flash_bytes_to_be_written) - target_ram_idx);
+                flash_status = flexible_program_block(bin_start_address, (uint8_t *)ff_buffer, (bin_start_address % flash.ram_to_flash_bytes_to_be_written) - target_ram_idx);
+                if (TARGET_OK != flash_status) {
+                    return flash_status;
+                }
             }
             return flexible_program_block(bin_start_address, bin_buffer, bin_buf_written);
         }
@@ -259,14 +564,23 @@ static target_flash_status_t program_hex(uint8_t *buf, uint32_t size)
                 // unaligned address. Write data to target RAM and force pad with ff //00
                 // Check if ram index needs to be shifted
                 if ( (bin_start_address % flash.ram_to_flash_bytes_to_be_written) > target_ram_idx ) {
-                    flexible_program_block(bin_start_address, (uint8_t *)ff_buffer, (bin_start_address % flash.ram_to_flash_bytes_to_be_written) - target_ram_idx);
+                    flash_status = flexible_program_block(bin_start_address, (uint8_t *)ff_buffer, (bin_start_address % flash.ram_to_flash_bytes_to_be_written) - target_ram_idx);
+                    if (TARGET_OK != flash_status) {
+                        return flash_status;
+                    }
+                }
+                flash_status = flexible_program_block(bin_start_address, bin_buffer, bin_buf_written);
+                if (TARGET_OK != flash_status) {
+                    return flash_status;
                 }
-                flexible_program_block(bin_start_address, bin_buffer, bin_buf_written);
             }
             
             // Check if rest of page needs to be padded
             if (target_ram_idx != 0) {
-                flexible_program_block(bin_start_address+bin_buf_written, (uint8_t *)ff_buffer, flash.ram_to_flash_bytes_to_be_written-target_ram_idx);
+                flash_status = flexible_program_block(bin_start_address+bin_buf_written, (uint8_t *)ff_buffer, flash.ram_to_flash_bytes_to_be_written-target_ram_idx);
+                if (TARGET_OK != flash_status) {
+                    return flash_status;
+                }
             }
                     
             // incrememntal offset to finish the block
@@ -278,14 +592,23 @@ static target_flash_status_t program_hex(uint8_t *buf, uint32_t size)
             if (bin_buf_written != 0) {
                 // Check if ram index needs to be shifted
                 if ( (bin_start_address % flash.ram_to_flash_bytes_to_be_written) > target_ram_idx ) {
-                    flexible_program_block(bin_start_address, (uint8_t *)ff_buffer, (bin_start_address % flash.ram_to_flash_bytes_to_be_written) - target_ram_idx);
+                    flash_status = flexible_program_block(bin_start_address, (uint8_t *)ff_buffer, (bin_start_address % flash.ram_to_flash_bytes_to_be_written) - target_ram_idx);
+                    if (TARGET_OK != flash_status) {
+                        return flash_status;
+                    }
+                }
+                flash_status = flexible_program_block(bin_start_address, bin_buffer, bin_buf_written);
+                if (TARGET_OK != flash_status) {
+                    return flash_status;
                 }
-                flexible_program_block(bin_start_address, bin_buffer, bin_buf_written);
             }
             
             // Check if rest of page needs to be padded
             if (target_ram_idx != 0) {
-                flexible_program_block(bin_start_address+bin_buf_written, (uint8_t *)ff_buffer, flash.ram_to_flash_bytes_to_be_written-target_ram_idx);
+                flash_status = flexible_program_block(bin_start_address+bin_buf_written, (uint8_t *)ff_buffer, flash.ram_to_flash_bytes_to_be_written-target_ram_idx);
+                if (TARGET_OK != flash_status) {
+                    return flash_status;
+                }
             }
             //target_ram_idx = 0;
             return TARGET_HEX_FILE_EOF;
@@ -298,3 +621,54 @@ static target_flash_status_t program_hex(uint8_t *buf, uint32_t size)
         }
     }
 }
+
+static target_flash_status_t program_hsz(uint8_t *buf, uint32_t size)
+{
+    heatshrink_decode_status_t status = HS_DECODE_OK;
+    target_flash_status_t flash_status = TARGET_OK;
+    uint32_t block_amt_parsed = 0;  // amount of compressed data consumed on the last call
+    uint32_t bin_buf_written = 0;   // amount of decompressed data in bin_buffer
+    uint32_t bin_buf_size = 0;
+    uint32_t pad = 0;
+
+    while (1) {
+        // never decode past the end of the page in target RAM so each block programs at most one page
+        bin_buf_size = flash.ram_to_flash_bytes_to_be_written - target_ram_idx;
+        if (bin_buf_size > sizeof(bin_buffer)) {
+            bin_buf_size = sizeof(bin_buffer);
+        }
+        status = heatshrink_decode_blob(buf, size, &block_amt_parsed, bin_buffer, bin_buf_size, &bin_buf_written);
+        if ((HS_DECODE_BAD_HEADER == status) || (HS_DECODE_FAILURE == status)) {
+            return (HS_DECODE_BAD_HEADER == status) ? TARGET_FAIL_HSZ_HEADER : TARGET_FAIL_HSZ_DECODE;
+        }
+        if (bin_buf_written != 0) {
+            flash_status = flexible_program_block(hsz_image_idx, bin_buffer, bin_buf_written);
+            if (TARGET_OK != flash_status) {
+                return flash_status;
+            }
+            hsz_image_idx += bin_buf_written;
+        }
+        size -= block_amt_parsed;
+        buf += block_amt_parsed;
+
+        if (HS_DECODE_OK == status) {
+            return TARGET_OK;
+        }
+        else if (HS_DECODE_EOF == status) {
+            // Check if rest of page needs to be padded
+            while (target_ram_idx != 0) {
+                pad = flash.ram_to_flash_bytes_to_be_written - target_ram_idx;
+                if (pad > sizeof(ff_buffer)) {
+                    pad = sizeof(ff_buffer);
+                }
+                flash_status = flexible_program_block(hsz_image_idx, (uint8_t *)ff_buffer, pad);
+                if (TARGET_OK != flash_status) {
+                    return flash_status;
+                }
+                hsz_image_idx += pad;
+            }
+            return TARGET_HSZ_FILE_EOF;
+        }
+        // HS_DECODE_OUTPUT_FULL - keep decoding the rest of the block
+    }
+}
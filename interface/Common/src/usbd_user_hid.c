@@ -21,6 +21,7 @@
 #include "usb_config.c"
 #include "DAP_config.h"
 #include "DAP.h"
+#include "dap_vendor_command.h"
 
 #include "main.h"
 
@@ -120,10 +121,29 @@ void usbd_hid_set_report (U8 rtype, U8 rid, U8 *buf, int len, U8 req) {
 }
 
 
-// Process USB HID Data
-void usbd_hid_process (void) {
+// Send the packet at USB_ResponseIn or queue it behind the ones in flight
+static void usbd_hid_send (void) {
     uint32_t n;
 
+    if (USB_ResponseIdle) {
+        // Request that data is send back to host
+        USB_ResponseIdle = 0;
+        usbd_hid_get_report_trigger(0, USB_Response[USB_ResponseIn], DAP_PACKET_SIZE);
+    } else {
+        // Update response index and flag
+        n = USB_ResponseIn + 1;
+        if (n == DAP_PACKET_COUNT) {
+            n = 0;
+        }
+        USB_ResponseIn = n;
+        if (USB_ResponseIn == USB_ResponseOut) {
+            USB_ResponseFlag = 1;
+        }
+    }
+}
+
+// Process USB HID Data
+void usbd_hid_process (void) {
     // Process pending requests
     while ((USB_RequestOut != USB_RequestIn) || USB_RequestFlag) {
         // Process DAP Command and prepare response
@@ -135,21 +155,17 @@ void usbd_hid_process (void) {
             USB_RequestFlag = 0;
         }
 
-        if (USB_ResponseIdle) {
-            // Request that data is send back to host
-            USB_ResponseIdle = 0;
-            usbd_hid_get_report_trigger(0, USB_Response[USB_ResponseIn], DAP_PACKET_SIZE);
-        } else {
-            // Update response index and flag
-            n = USB_ResponseIn + 1;
-            if (n == DAP_PACKET_COUNT) {
-                n = 0;
-            }
-            USB_ResponseIn = n;
-            if (USB_ResponseIn == USB_ResponseOut) {
-                USB_ResponseFlag = 1;
-            }
-        }
+        usbd_hid_send();
+    }
+}
+
+// Run the halt watch when no request is waiting and a response slot is free
+static void usbd_hid_notify (void) {
+    if ((USB_RequestOut != USB_RequestIn) || USB_RequestFlag || USB_ResponseFlag) {
+        return;
+    }
+    if (halt_watch_poll(USB_Response[USB_ResponseIn])) {
+        usbd_hid_send();
     }
 }
 
@@ -158,9 +174,11 @@ void usbd_hid_process (void) {
 __task void hid_process(void * argv) {
     dapTask = os_tsk_self();
     while (1) {
-        os_evt_wait_or(DAP_PAQUET_RECEIVED, 0xffff);
-        usbd_hid_process ();
-        main_blink_dap_led(0);
+        if (OS_R_EVT == os_evt_wait_or(DAP_PAQUET_RECEIVED, halt_watch_timeout())) {
+            usbd_hid_process ();
+            main_blink_dap_led(0);
+        }
+        usbd_hid_notify();
     }
 }
 
@@ -21,7 +21,10 @@
 #include "usb_buf.h"
 #include "virtual_fs.h"
 #include "daplink_debug.h"
-#include "version.h"
+#include "program_profile.h"
+#include "gdb_server.h"
+
+program_profile_t program_profile;
 
 void usbd_msc_init(void)
 {    
@@ -39,12 +42,6 @@ void usbd_msc_init(void)
 
 void usbd_msc_read_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
 {
-    virtual_media_t fs_read = {0,0};
-    uint32_t max_known_fs_entry_addr = 0;
-    uint32_t req_sector_offset = 0;
-    uint32_t req_addr = block * USBD_MSC_BlockSize;
-    uint8_t i = 0, real_data_present = 1;
-    
     // dont proceed if we're not ready
     if (!USBD_MSC_MediaReady) {
         return;
@@ -54,38 +51,9 @@ void usbd_msc_read_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
     main_blink_msd_led(0);
     
     // A block is requested from the host. We dont have a flat file system image on disc
-    //  rather just the required bits (mbr, fat, root dir, file data). The fs structure 
-    //  knows how these parts look without requiring them all to exist linearly in memory
-    while((fs[i].length != 0) && (fs_read.sect == 0)) {
-        // accumulate the length of the fs.sect(s) we have examined so far
-        max_known_fs_entry_addr += fs[i].length;
-        // determine if we have real system data or need to pad the transfer with 0
-        if (req_addr < max_known_fs_entry_addr) {
-            // we know this is where the data request is, store it for later transmission
-            fs_read.sect = fs[i].sect;
-            // sector can be larger than a block. Normalize the block number into the fs entry
-            req_sector_offset = fs[i].length - (max_known_fs_entry_addr - req_addr);
-            // determine if the inflated size is greater than the real size.
-            if(req_sector_offset >= sizeof(fs[i].sect)) {
-                real_data_present = 0;
-            }
-        }
-        i++;
-    }
-    // now send the data if a known sector and valid data in memory - otherwise send 0's
-    if (fs_read.sect != 0 && real_data_present == 1) {
-        memcpy(buf, &fs_read.sect[req_sector_offset], num_of_blocks * USBD_MSC_BlockSize);
-    }
-    else {
-        memset(buf, 0, num_of_blocks * USBD_MSC_BlockSize);
-    }
-    
-    // Some files require runtime content. If one generate and overwrite the the read sequence
-    //  buffer with the newer data (only works for files < 512 bytes and known location on fs)
-    if (block == (mbr.reserved_logical_sectors + (mbr.logical_sectors_per_fat*mbr.num_fats) 
-        + ((mbr.max_root_dir_entries*sizeof(FatDirectoryEntry_t)/mbr.bytes_per_sector)))) {
-        update_html_file(buf, (num_of_blocks * USBD_MSC_BlockSize));
-    }
+    //  rather just the required bits (mbr, fat, root dir, file data). The virtual fs keeps an
+    //  index of where these parts live so any block is found without walking the fs structure
+    virtual_fs_read_sect(block, buf, num_of_blocks);
 }
 
 static uint32_t filename_valid(uint8_t c)
@@ -118,7 +86,10 @@ static uint32_t wanted_dir_entry(const FatDirectoryEntry_t dir_entry)
 
 static extension_t identify_start_sequence(uint8_t *buf)
 {
-    if (1 == validate_bin_nvic(buf)) {
+    if (1 == validate_compressed_image(buf)) {
+        return HSZ;
+    }
+    else if (1 == validate_bin_nvic(buf)) {
         return BIN;
     }
     else if (1 == validate_hexfile(buf)) {
@@ -127,12 +98,155 @@ static extension_t identify_start_sequence(uint8_t *buf)
     return UNKNOWN;
 }
 
-void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
+static uint32_t data_region_start(void)
+{
+    return mbr.reserved_logical_sectors + (mbr.num_fats * mbr.logical_sectors_per_fat)
+        + ((mbr.max_root_dir_entries * sizeof(FatDirectoryEntry_t)) / mbr.bytes_per_sector);
+}
+
+static uint32_t block_to_cluster(uint32_t block)
+{
+    return ((block - data_region_start()) / mbr.sectors_per_cluster) + 2;
+}
+
+static uint32_t cluster_to_block(uint32_t cluster)
+{
+    return data_region_start() + ((cluster - 2) * mbr.sectors_per_cluster);
+}
+
+// FAT12 packs 2 entries in 3 bytes so an entry can straddle two FAT sectors. The last
+//  byte of each FAT sector written is kept to resolve that when the next one arrives
+static uint8_t fat_prev_byte = 0;
+static uint32_t fat_prev_block = 0;
+
+static int32_t read_fat12_entry(uint32_t block, const uint8_t *buf, uint32_t cluster)
+{
+    uint32_t sector_start = (block - mbr.reserved_logical_sectors) * mbr.bytes_per_sector;
+    uint32_t offset = cluster + (cluster / 2);
+    uint32_t entry = 0;
+    
+    if ((offset >= sector_start) && ((offset + 1) < (sector_start + mbr.bytes_per_sector))) {
+        entry = buf[offset - sector_start] | (buf[offset - sector_start + 1] << 8);
+    }
+    else if (((offset + 1) == sector_start) && (fat_prev_block == (block - 1))) {
+        entry = fat_prev_byte | (buf[0] << 8);
+    }
+    else {
+        // entry lives in a FAT sector that hasn't been written yet
+        return -1;
+    }
+    return (cluster & 1) ? (entry >> 4) : (entry & 0xfff);
+}
+
+// Walk the cluster chain of the file as far as the FAT written so far allows. When the end
+//  of chain marker is found the last sector the host can write for the file is known. A host
+//  can flush the FAT while the file is still growing, so the end found is read again on
+//  every FAT write and the walk goes on when the chain was extended
+static void follow_fat_chain(uint32_t block, const uint8_t *buf)
+{
+    uint32_t origin = (file_transfer_state.transfer_started) ? file_transfer_state.start_cluster : file_transfer_state.hint_cluster;
+    uint32_t max_clusters = mbr.total_logical_sectors / mbr.sectors_per_cluster;
+    int32_t next = 0;
+    
+    if (origin < 2) {
+        return;
+    }
+    if (origin != file_transfer_state.chain_origin) {
+        file_transfer_state.chain_origin = origin;
+        file_transfer_state.chain_cluster = origin;
+        file_transfer_state.last_chain_block = 0;
+    }
+    // a loop in the chain would be a corrupt FAT, stop after touching every cluster once
+    while (max_clusters--) {
+        next = read_fat12_entry(block, buf, file_transfer_state.chain_cluster);
+        if (next < 0) {
+            break;
+        }
+        if (next >= 0xff8) {
+            file_transfer_state.last_chain_block = cluster_to_block(file_transfer_state.chain_cluster) + mbr.sectors_per_cluster - 1;
+            debug_msg("chain end: %d\r\n", file_transfer_state.last_chain_block);
+            break;
+        }
+        // the end found before is gone
+        file_transfer_state.last_chain_block = 0;
+        if ((next < 2) || (next >= 0xff0)) {
+            // the host hasn't allocated the chain yet. Start over on the next FAT update
+            file_transfer_state.chain_cluster = origin;
+            break;
+        }
+        file_transfer_state.chain_cluster = next;
+    }
+    fat_prev_byte = buf[mbr.bytes_per_sector - 1];
+    fat_prev_block = block;
+}
+
+// The chain may only end where the host had allocated to when it flushed the FAT. Its end
+//  finishes the transfer when the data has been written up to it and the size in the dir
+//  entry ends in the same cluster
+static uint8_t chain_end_reached(void)
+{
+    uint32_t last_block = 0;
+    
+    if ((0 == file_transfer_state.transfer_started) || (0 == file_transfer_state.last_chain_block) ||
+        (file_transfer_state.chain_origin != file_transfer_state.start_cluster) ||
+        (file_transfer_state.last_block_written < file_transfer_state.last_chain_block)) {
+        return 0;
+    }
+    if ((0 == file_transfer_state.amt_to_write) || (0xffffffff == file_transfer_state.amt_to_write)) {
+        return 0;
+    }
+    last_block = file_transfer_state.start_block + ((file_transfer_state.amt_to_write - 1) / USBD_MSC_BlockSize);
+    return (block_to_cluster(last_block) == block_to_cluster(file_transfer_state.last_chain_block));
+}
+
+// Time from the first block of an image to the eject. Published in PROGRAM.TXT
+static void profile_start(void)
+{
+    memset(&program_profile, 0, sizeof(program_profile));
+    program_profile.start_us = profile_time_us();
+    program_profile.last_us = program_profile.start_us;
+    program_profile.active = 1;
+}
+
+static void profile_stop(void)
+{
+    if (program_profile.active) {
+        program_profile.total_us = profile_time_us() - program_profile.start_us;
+        program_profile.bytes = file_transfer_state.amt_written;
+        program_profile.active = 0;
+        program_profile.done = (PROGRAM_PROFILE == 1);
+    }
+}
+
+static void parse_root_dir(uint8_t *buf)
 {
     FatDirectoryEntry_t tmp_file = {0};
+    uint32_t i = 0;
+    
+    // start looking for a known file and some info about it
+    for( ; i < USBD_MSC_BlockSize/sizeof(tmp_file); i++) {
+        memcpy(&tmp_file, &buf[i*sizeof(tmp_file)], sizeof(tmp_file));
+        debug_msg("na:%.11s\tatrb:%8d\tsz:%8d\tst:%8d\tcr:%8d\tmod:%8d\taccd:%8d\r\n"
+            , tmp_file.filename, tmp_file.attributes, tmp_file.filesize, tmp_file.first_cluster_low_16
+            , tmp_file.creation_time_ms, tmp_file.modification_time, tmp_file.accessed_date);
+        // test for a known dir entry file type and also that the filesize is greater than 0
+        if (1 == wanted_dir_entry(tmp_file)) {
+            if (0 == file_transfer_state.transfer_started) {
+                // the directory was updated before the data. Keep it for when the data arrives
+                file_transfer_state.hint_cluster = tmp_file.first_cluster_low_16;
+                file_transfer_state.hint_filesize = tmp_file.filesize;
+            }
+            else if (tmp_file.first_cluster_low_16 == file_transfer_state.start_cluster) {
+                file_transfer_state.amt_to_write = tmp_file.filesize;
+            }
+        }
+    }
+}
+
+void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
+{
     extension_t start_type_identified = UNKNOWN;
     target_flash_status_t status = TARGET_OK;
-    uint32_t i = 0;
     
     if (!USBD_MSC_MediaReady) {
         return;
@@ -145,6 +259,10 @@ void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
     
     
     debug_msg("block: %d\r\n", block);
+    // time the host took to send this block
+    if (program_profile.active) {
+        profile_phase(PROFILE_USB, program_profile.last_us);
+    }
     // indicate msd activity
     main_blink_msd_led(0);
       
@@ -163,8 +281,19 @@ void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
             file_transfer_state.last_block_written = block;
             file_transfer_state.transfer_started = 1;
             file_transfer_state.file_type = start_type_identified;
+            file_transfer_state.start_cluster = block_to_cluster(block);
+            // the dir entry for this file may already be known
+            if (file_transfer_state.hint_cluster == file_transfer_state.start_cluster) {
+                file_transfer_state.amt_to_write = file_transfer_state.hint_filesize;
+            }
             
+            // the gdb server drives the same swd port and flash algorithm
+            if (gdb_server_active()) {
+                status = TARGET_FAIL_GDB_ACTIVE;
+                goto msc_fail_exit;
+            }
             // prepare the target device
+            profile_start();
             status = target_flash_init(file_transfer_state.file_type);
             if (status != TARGET_OK) {
                 goto msc_fail_exit;
@@ -174,26 +303,21 @@ void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
             //debug_data(buf, USBD_MSC_BlockSize);
             status = target_flash_program_page((block-file_transfer_state.start_block)*USBD_MSC_BlockSize, buf, USBD_MSC_BlockSize*num_of_blocks);
             debug_msg("%d\r\n", status);
-            if ((status != TARGET_OK) && (status != TARGET_HEX_FILE_EOF)) {
+            if ((status != TARGET_OK) && (status != TARGET_HEX_FILE_EOF) && (status != TARGET_HSZ_FILE_EOF)) {
                 goto msc_fail_exit;
             }
             goto msc_complete;
         }
     }
     // if the root dir comes we should look at it and parse for info that can end a transfer
-    else if ((block == ((mbr.num_fats * mbr.logical_sectors_per_fat) + 1)) || 
-             (block == ((mbr.num_fats * mbr.logical_sectors_per_fat) + 2))) {
-        // start looking for a known file and some info about it
-        for( ; i < USBD_MSC_BlockSize/sizeof(tmp_file); i++) {
-            memcpy(&tmp_file, &buf[i*sizeof(tmp_file)], sizeof(tmp_file));
-            debug_msg("na:%.11s\tatrb:%8d\tsz:%8d\tst:%8d\tcr:%8d\tmod:%8d\taccd:%8d\r\n"
-                , tmp_file.filename, tmp_file.attributes, tmp_file.filesize, tmp_file.first_cluster_low_16
-                , tmp_file.creation_time_ms, tmp_file.modification_time, tmp_file.accessed_date);
-            // test for a known dir entry file type and also that the filesize is greater than 0
-            if (1 == wanted_dir_entry(tmp_file)) {
-                file_transfer_state.amt_to_write = tmp_file.filesize;
-            }
-        }
+    if ((block == ((mbr.num_fats * mbr.logical_sectors_per_fat) + 1)) || 
+        (block == ((mbr.num_fats * mbr.logical_sectors_per_fat) + 2))) {
+        parse_root_dir(buf);
+    }
+    // the first FAT tells us where the file ends long before the dir entry may be flushed
+    else if ((block >= mbr.reserved_logical_sectors) && 
+             (block < (mbr.reserved_logical_sectors + mbr.logical_sectors_per_fat))) {
+        follow_fat_chain(block, buf);
     }
 
     // write data to media
@@ -210,7 +334,7 @@ void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
                 //debug_data(buf, USBD_MSC_BlockSize);
                 status = target_flash_program_page((block-file_transfer_state.start_block)*USBD_MSC_BlockSize, buf, USBD_MSC_BlockSize*num_of_blocks);
                 debug_msg("%d\r\n", status);
-                if ((status != TARGET_OK) && (status != TARGET_HEX_FILE_EOF)) {
+                if ((status != TARGET_OK) && (status != TARGET_HEX_FILE_EOF) && (status != TARGET_HSZ_FILE_EOF)) {
                     goto msc_fail_exit;
                 }
                 // and do the housekeeping
@@ -221,29 +345,35 @@ void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
     }
     
 msc_complete:
-    // see if a complete transfer occured by knowing it started and comparing filesize expectations (BIN)
-    //  finding an EOF from hex file (HEX)
+    // see if a complete transfer occured by knowing it started and comparing filesize expectations (BIN),
+    //  writing the last sector of the cluster chain from the FAT, finding an EOF from hex file (HEX)
+    //  or the end of the decompressed image (HSZ)
     if (((file_transfer_state.amt_written >= file_transfer_state.amt_to_write) && (file_transfer_state.transfer_started == 1 )) || 
-         (TARGET_HEX_FILE_EOF == status)) {
+        chain_end_reached() || (TARGET_HEX_FILE_EOF == status) || (TARGET_HSZ_FILE_EOF == status)) {
         // hex file complete exit needs to look like binary file complete exit
-        status = TARGET_OK;
+        status = target_flash_uninit();
+        if (status != TARGET_OK) {
+            goto msc_fail_exit;
+        }
         // do the disconnect - maybe write some programming stats to the file
         debug_msg("%s", "FLASH END\r\n");
         // we know the contents have been reveived. Time to eject
         file_transfer_state.transfer_started = 0;
+        profile_stop();
         configure_fail_txt(status);
         main_msc_disconnect_event();
         return;
     }
     
-    // There is one more known state where the root dir is updated with the amount of data transfered but not the whole file transfer was complete
-    //  To handle this we need a state to kick off a timer for a fixed amount of time where we can receive more continous sectors and assume
-    //  they are valid file data. This is only the case for bin files since the only known end is the filesize from the root dir entry.
+    // The FAT only gives the end of the file to cluster granularity. When the file doesn't fill its last cluster
+    //  the exact end is still only known from the dir entry, which may arrive before or after the data.
+    program_profile.last_us = profile_time_us();
     return;
     
 msc_fail_exit:
     file_transfer_state.transfer_started = 0;
     file_transfer_state.transfer_failed = 1;
+    profile_stop();
     configure_fail_txt(status);
     main_force_msc_disconnect_event();
     return;
@@ -18,6 +18,13 @@
 #include "string.h"
 #include "version.h"
 #include "version_git.h"
+#include "swd_host.h"
+#include "target_reset.h"
+#include "dap_telemetry.h"
+#include "program_profile.h"
+#include "semihost.h"
+#include "gdb_server.h"
+#include "RTL.h"
 
 // mbr is in RAM so the members can be updated at runtime to change drive capacity based
 //  on target MCU that is attached
@@ -82,18 +89,11 @@ mbr_t mbr = {
 };
 
 // FAT is only valid for files on disc that are part of this file. Not writeable during
-//  MSC transfer operations
-static const file_allocation_table_t fat = {
-    .f = {
-        0xF8, 0xFF, 
-        0xFF, 0xFF,
-        0xFF, 0xFF,
-        0xFF, 0xFF,
-        0xFF, 0xFF,
-        0xFF, 0xFF,
-        0x00, 0x00,
-    }
-};
+//  MSC transfer operations. It is generated when read since the FLASH.BIN cluster chain
+//  depends on the size of the target flash
+#define VFS_FLASH_BIN_CLUSTER   (6)
+// FAT12 can't address more clusters than this
+#define VFS_MAX_CLUSTERS        (4084)
 
 // Tool for release awareness and tracking
 #if (GIT_LOCAL_MODS == 1)
@@ -128,6 +128,9 @@ static const uint8_t details_file[512] =
 static const uint8_t fail_file[512] =
     "Placeholder for fail.txt data\r\n";
 
+static const uint8_t program_file[512] =
+    "Time spent programming the last image\r\n";
+
 static FatDirectoryEntry_t const fail_txt_dir_entry = {
 /*uint8_t[11] */ .filename = "FAIL    TXT",
 /*uint8_t */ .attributes = 0x01,
@@ -139,10 +142,42 @@ static FatDirectoryEntry_t const fail_txt_dir_entry = {
 /*uint16_t*/ .first_cluster_high_16 = 0x0000,
 /*uint16_t*/ .modification_time = 0x83dc,
 /*uint16_t*/ .modification_date = 0x34bb,
-/*uint16_t*/ .first_cluster_low_16 = 0x0004,    // always must be last sector
+/*uint16_t*/ .first_cluster_low_16 = 0x0004,    // always must be before FLASH.BIN
 /*uint32_t*/ .filesize = sizeof(fail_file)
 };
 
+// timing of the last drag-and-drop. Only listed once something was programmed
+static FatDirectoryEntry_t const program_txt_dir_entry = {
+/*uint8_t[11] */ .filename = "PROGRAM TXT",
+/*uint8_t */ .attributes = 0x01,
+/*uint8_t */ .reserved = 0x00,
+/*uint8_t */ .creation_time_ms = 0x00,
+/*uint16_t*/ .creation_time = 0x0000,
+/*uint16_t*/ .creation_date = 0x0021,
+/*uint16_t*/ .accessed_date = 0xbb32,
+/*uint16_t*/ .first_cluster_high_16 = 0x0000,
+/*uint16_t*/ .modification_time = 0x83dc,
+/*uint16_t*/ .modification_date = 0x34bb,
+/*uint16_t*/ .first_cluster_low_16 = 0x0005,    // always must be before FLASH.BIN
+/*uint32_t*/ .filesize = 0
+};
+
+// contents of the target flash read over SWD. Size is patched to the target flash at runtime
+static FatDirectoryEntry_t const flash_bin_dir_entry = {
+/*uint8_t[11] */ .filename = "FLASH   BIN",
+/*uint8_t */ .attributes = 0x01,
+/*uint8_t */ .reserved = 0x00,
+/*uint8_t */ .creation_time_ms = 0x00,
+/*uint16_t*/ .creation_time = 0x0000,
+/*uint16_t*/ .creation_date = 0x0021,
+/*uint16_t*/ .accessed_date = 0xbb32,
+/*uint16_t*/ .first_cluster_high_16 = 0x0000,
+/*uint16_t*/ .modification_time = 0x83dc,
+/*uint16_t*/ .modification_date = 0x34bb,
+/*uint16_t*/ .first_cluster_low_16 = VFS_FLASH_BIN_CLUSTER,
+/*uint32_t*/ .filesize = 0
+};
+
 static FatDirectoryEntry_t const empty_dir_entry = {
 /*uint8_t[11] */ .filename = {0},
 /*uint8_t */ .attributes = 0x00,
@@ -247,8 +282,8 @@ static const uint8_t blank_reigon[512] = {0};
 virtual_media_t fs[] = {
     // fs setup
     {(uint8_t *)&mbr, sizeof(mbr)},
-    {(uint8_t *)&fat, sizeof(fat)},
-    {(uint8_t *)&fat, sizeof(fat)},
+    {(uint8_t *)0, sizeof(file_allocation_table_t)},
+    {(uint8_t *)0, sizeof(file_allocation_table_t)},
     
     // root dir
     {(uint8_t *)&dir1, sizeof(dir1)},
@@ -261,6 +296,10 @@ virtual_media_t fs[] = {
     {(uint8_t *)&details_file, sizeof(details_file)},
     {(uint8_t *)&blank_reigon, sizeof(blank_reigon)},
     {(uint8_t *)&fail_file,    sizeof(fail_file)},
+    {(uint8_t *)&blank_reigon, sizeof(blank_reigon)},
+    {(uint8_t *)&program_file, sizeof(program_file)},
+    {(uint8_t *)&blank_reigon, sizeof(blank_reigon)},
+    // FLASH.BIN follows and is read from the target
     
     // add other meaningful file data entries here
     
@@ -268,46 +307,389 @@ virtual_media_t fs[] = {
     {(uint8_t *)0, 0},
 };
 
+// Reads are served from an index built once by virtual_fs_init(). Every block in the known
+//  area of the disc maps straight to the fs[] entry that starts there, anything else reads as 0.
+//  Sized for the largest FAT12 disc (1 mbr + 2*24 FAT + 2 root dir + 32 file data blocks)
+#define VFS_INDEXED_SECTORS (83)
+#define VFS_ZERO_SECTOR     (0xff)
+#define VFS_FS_ENTRIES      (sizeof(fs)/sizeof(fs[0]))
+
+static uint8_t sector_map[VFS_INDEXED_SECTORS];
+// amount of real data at the start of each fs[] entry, the remainder of the block reads as 0
+static uint16_t fs_data_length[VFS_FS_ENTRIES];
+// blocks regenerated on every read
+static uint32_t html_block;
+static uint32_t details_block;
+static uint32_t program_block;
+
+// DETAILS.TXT ends with the SWD/JTAG transfer counters and PROGRAM.TXT is made of the
+//  programming times. Numbers have a fixed width so the file size set in the dir entry
+//  stays right as they change
+#define DETAILS_VALUE_WIDTH (10)
+
+typedef struct {
+    const char *label;
+    uint8_t values;
+} details_line_t;
+
+static const details_line_t details_lines[] = {
+    {"Transfers OK:      ", 1},
+    {"Transfers/s:       ", 1},
+    {"WAIT acks:         ", 1},
+    {"FAULT acks:        ", 1},
+    {"No ack:            ", 1},
+    {"Parity errors:     ", 1},
+    {"Protocol errors:   ", 1},
+    {"WAIT runs 1,2,4..32", TELEMETRY_WAIT_BUCKETS},
+    {"Retries exhausted: ", 1},
+    {"Transfer aborts:   ", 1},
+};
+
+static const details_line_t program_lines[] = {
+    {"Total us:          ", 1},
+    {"KB/s:              ", 1},
+    {"Bytes:             ", 1},
+    {"Reset us:          ", 1},
+    {"Flash algo us:     ", 1},
+    {"Erase us:          ", 1},
+    {"Data to RAM us:    ", 1},
+    {"Program us:        ", 1},
+    {"Verify us:         ", 1},
+    {"USB wait us:       ", 1},
+    {"Other us:          ", 1},
+    {"Pages:             ", 1},
+    {"Page min,max us:   ", 2},
+};
+
+// FLASH.BIN is read ahead of the host so consecutive blocks share one SWD block read. 1KB
+//  never crosses a TAR auto-increment page on any target
+#define VFS_FLASH_CACHE_SIZE (1024)
+
+static uint32_t flash_bin_size;
+static uint32_t flash_bin_clusters;
+static uint32_t flash_bin_block;
+static uint8_t flash_bin_attached = 0;
+static uint32_t flash_cache_addr = 0xffffffff;
+static uint8_t flash_cache[VFS_FLASH_CACHE_SIZE];
+
+static uint32_t fat12_entry(uint32_t cluster)
+{
+    if (0 == cluster) {
+        return 0xf00 | mbr.media_descriptor;
+    }
+    // reserved entry and the single cluster files
+    if (cluster < VFS_FLASH_BIN_CLUSTER) {
+        return 0xfff;
+    }
+    // FLASH.BIN is one contiguous chain
+    if (cluster < (VFS_FLASH_BIN_CLUSTER + flash_bin_clusters - 1)) {
+        return cluster + 1;
+    }
+    if (cluster == (VFS_FLASH_BIN_CLUSTER + flash_bin_clusters - 1)) {
+        return 0xfff;
+    }
+    return 0;
+}
+
+static void fat_read_sect(uint32_t sector, uint8_t *buf)
+{
+    uint32_t i = 0, pair = 0;
+    uint32_t offset = sector * mbr.bytes_per_sector;
+    
+    // nothing allocated past the end of FLASH.BIN
+    if ((offset / 3 * 2) > (VFS_FLASH_BIN_CLUSTER + flash_bin_clusters)) {
+        memset(buf, 0, mbr.bytes_per_sector);
+        return;
+    }
+    // 2 entries are packed into every 3 bytes
+    for (i = 0; i < mbr.bytes_per_sector; i++, offset++) {
+        pair = (offset / 3) * 2;
+        switch (offset % 3) {
+            case 0:
+                buf[i] = fat12_entry(pair) & 0xff;
+                break;
+            case 1:
+                buf[i] = ((fat12_entry(pair) >> 8) & 0x0f) | ((fat12_entry(pair + 1) & 0x0f) << 4);
+                break;
+            default:
+                buf[i] = (fat12_entry(pair + 1) >> 4) & 0xff;
+                break;
+        }
+    }
+}
+
+static void flash_bin_read_sect(uint32_t offset, uint8_t *buf)
+{
+    uint32_t addr = offset - (offset % VFS_FLASH_CACHE_SIZE);
+    uint8_t paused = 0;
+    
+    // the target is being programmed, nothing meaningful to read
+    if (file_transfer_state.transfer_started) {
+        memset(buf, 0xff, mbr.bytes_per_sector);
+        return;
+    }
+    if (addr != flash_cache_addr) {
+        flash_cache_addr = 0xffffffff;
+        // stop semihost polling first so its SWD accesses are not cut in half
+        paused = semihost_pause();
+        // a debugger or the gdb server owns the debug port. Leave it alone
+        if (gdb_server_active() || !swd_port_take(0)) {
+            flash_bin_attached = 0;
+            memset(buf, 0xff, mbr.bytes_per_sector);
+            if (paused) {
+                semihost_resume();
+            }
+            return;
+        }
+        // attach to the running target without a reset or a DHCSR write.
+        // Retry once if the link was lost
+        if (0 == flash_bin_attached) {
+            flash_bin_attached = swd_attach();
+        }
+        if (0 == swd_read_memory(target_device.flash_start + addr, flash_cache, VFS_FLASH_CACHE_SIZE)) {
+            flash_bin_attached = swd_attach();
+            if ((0 == flash_bin_attached) || 
+                (0 == swd_read_memory(target_device.flash_start + addr, flash_cache, VFS_FLASH_CACHE_SIZE))) {
+                swd_port_release();
+                if (paused) {
+                    semihost_resume();
+                }
+                // read as unprogrammed flash, like the other cases with nothing to read
+                memset(buf, 0xff, mbr.bytes_per_sector);
+                return;
+            }
+        }
+        swd_port_release();
+        if (paused) {
+            semihost_resume();
+        }
+        flash_cache_addr = addr;
+    }
+    memcpy(buf, &flash_cache[offset - addr], mbr.bytes_per_sector);
+}
+
+static uint32_t lines_length(const details_line_t *lines, uint32_t count)
+{
+    uint32_t i = 0, length = 0;
+    for (i = 0; i < count; i++) {
+        length += strlen(lines[i].label) + (lines[i].values * (DETAILS_VALUE_WIDTH + 1)) + 2;
+    }
+    return length;
+}
+
+// labels followed by right aligned decimal values
+static uint8_t *write_lines(uint8_t *p, const details_line_t *lines, uint32_t count, const uint32_t *values)
+{
+    uint32_t i = 0, j = 0, k = 0, v = 0, length = 0;
+    for (i = 0; i < count; i++) {
+        length = strlen(lines[i].label);
+        memcpy(p, lines[i].label, length);
+        p += length;
+        for (j = 0; j < lines[i].values; j++) {
+            *p++ = ' ';
+            v = *values++;
+            for (k = DETAILS_VALUE_WIDTH; k; k--) {
+                p[k - 1] = ((k == DETAILS_VALUE_WIDTH) || v) ? ('0' + (v % 10)) : ' ';
+                v /= 10;
+            }
+            p += DETAILS_VALUE_WIDTH;
+        }
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    return p;
+}
+
+static uint32_t details_length(void)
+{
+    uint32_t length = strlen((const char *)details_file);
+#if (DAP_TELEMETRY == 1)
+    length += lines_length(details_lines, sizeof(details_lines) / sizeof(details_lines[0]));
+#endif
+    return length;
+}
+
+static uint32_t program_length(void)
+{
+    return strlen((const char *)program_file) + lines_length(program_lines, sizeof(program_lines) / sizeof(program_lines[0]));
+}
+
+static void update_details_file(uint8_t *buf, uint32_t bufsize)
+{
+    uint32_t values[7 + TELEMETRY_WAIT_BUCKETS + 2];
+    uint32_t i = 0, n = 0, seconds = 0, length = strlen((const char *)details_file);
+    
+    memset(buf, 0, bufsize);
+    memcpy(buf, details_file, length);
+#if (DAP_TELEMETRY == 1)
+    values[n++] = dap_telemetry.ack[TELEMETRY_ACK_OK];
+    seconds = (os_time_get() - dap_telemetry.reset_time) / 100;
+    values[n++] = seconds ? (dap_telemetry.ack[TELEMETRY_ACK_OK] / seconds) : 0;
+    values[n++] = dap_telemetry.ack[TELEMETRY_ACK_WAIT];
+    values[n++] = dap_telemetry.ack[TELEMETRY_ACK_FAULT];
+    values[n++] = dap_telemetry.ack[TELEMETRY_ACK_NONE];
+    values[n++] = dap_telemetry.ack[TELEMETRY_ACK_PARITY];
+    values[n++] = telemetry_protocol_errors();
+    for (i = 0; i < TELEMETRY_WAIT_BUCKETS; i++) {
+        values[n++] = dap_telemetry.wait_hist[i];
+    }
+    values[n++] = dap_telemetry.retry_exhausted;
+    values[n++] = dap_telemetry.aborts;
+    if (details_length() > bufsize) {
+        return;
+    }
+    write_lines(buf + length, details_lines, sizeof(details_lines) / sizeof(details_lines[0]), values);
+#endif
+}
+
+static void update_program_file(uint8_t *buf, uint32_t bufsize)
+{
+    uint32_t values[3 + PROFILE_PHASES + 1 + 3];
+    uint32_t i = 0, n = 0, other = program_profile.total_us, length = strlen((const char *)program_file);
+    
+    memset(buf, 0, bufsize);
+    memcpy(buf, program_file, length);
+    values[n++] = program_profile.total_us;
+    values[n++] = program_profile.total_us ? (uint32_t)(((uint64_t)program_profile.bytes * 1000000) / ((uint64_t)program_profile.total_us * 1024)) : 0;
+    values[n++] = program_profile.bytes;
+    for (i = 0; i < PROFILE_PHASES; i++) {
+        values[n++] = program_profile.phase_us[i];
+        other = (other > program_profile.phase_us[i]) ? (other - program_profile.phase_us[i]) : 0;
+    }
+    // parsing, FAT and dir handling and everything else not timed on its own
+    values[n++] = other;
+    values[n++] = program_profile.pages;
+    values[n++] = program_profile.page_min_us;
+    values[n++] = program_profile.page_max_us;
+    if (program_length() > bufsize) {
+        return;
+    }
+    write_lines(buf + length, program_lines, sizeof(program_lines) / sizeof(program_lines[0]), values);
+}
+
 // when a fail condition occurs we need to update the data stored on disc and also
 //  the directory entry. fs[] entry and dir entry need to be looked at and may need
 //  modification if/when more files are added to the file-system
 void configure_fail_txt(target_flash_status_t reason)
 {
     // set the dir entry to a file or empty it
-    dir1.f3 = (TARGET_OK == reason) ? empty_dir_entry : fail_txt_dir_entry;
+    dir1.f4 = (TARGET_OK == reason) ? empty_dir_entry : fail_txt_dir_entry;
     // update the filesize (pass/fail)
-    dir1.f3.filesize = strlen((const char *)fail_txt_contents[reason]);
+    dir1.f4.filesize = strlen((const char *)fail_txt_contents[reason]);
     // and the memory that we point to (file contents)
     fs[9].sect = (uint8_t *)fail_txt_contents[reason];
+    fs_data_length[9] = dir1.f4.filesize;
+    // PROGRAM.TXT takes the next entry. An empty entry before it would end the listing
+    dir1.f5 = empty_dir_entry;
+    if (program_profile.done) {
+        if (TARGET_OK == reason) {
+            dir1.f4 = program_txt_dir_entry;
+            dir1.f4.filesize = program_length();
+        }
+        else {
+            dir1.f5 = program_txt_dir_entry;
+            dir1.f5.filesize = program_length();
+        }
+    }
+    // the target was just programmed so FLASH.BIN contents changed
+    flash_cache_addr = 0xffffffff;
 }
 
 // Update known entries and mbr data when the program boots
 void virtual_fs_init(void)
 {
+    uint32_t i = 0, block = 0;
     // 64KB is mbr, FATs, root dir, ect...
     //uint32_t wanted_size_in_bytes   = (target_device.disc_size + KB(64);
     //uint32_t number_sectors_needed  = (wanted_size_in_bytes / mbr.bytes_per_sector);
     //uint32_t number_clusters_needed = (number_sectors_needed / mbr.sectors_per_cluster);
     //uint32_t fat_sector_size =        (((number_clusters_needed / 1023) / 1024) * 3);
     // number of sectors = (media size in bytes) / bytes per sector
-    mbr.total_logical_sectors = ((target_device.disc_size + kB(64)) / mbr.bytes_per_sector);
+    uint32_t max_flash_bin = 0;
+    
+    // FLASH.BIN covers the target flash but the disc must still have room for a new image
+    //  and stay within what FAT12 can address
+    flash_bin_size = target_device.flash_end - target_device.flash_start;
+    max_flash_bin = (VFS_MAX_CLUSTERS * mbr.sectors_per_cluster * mbr.bytes_per_sector) - (target_device.disc_size + kB(64));
+    if (flash_bin_size > max_flash_bin) {
+        flash_bin_size = max_flash_bin - (max_flash_bin % VFS_FLASH_CACHE_SIZE);
+    }
+    flash_bin_clusters = (flash_bin_size + (mbr.sectors_per_cluster * mbr.bytes_per_sector) - 1) / (mbr.sectors_per_cluster * mbr.bytes_per_sector);
+    dir1.f3 = flash_bin_dir_entry;
+    dir1.f3.filesize = flash_bin_size;
+    mbr.total_logical_sectors = ((target_device.disc_size + flash_bin_size + kB(64)) / mbr.bytes_per_sector);
     // number of cluster = ((number of sectors) / sectors per cluster)
     // secotrs per fat   = (3 x ((number of clusters + 1023) / 1024))
     mbr.logical_sectors_per_fat = (3 * (((mbr.total_logical_sectors / mbr.sectors_per_cluster) + 1023) / 1024));
     // patch root direcotry entries
     //dir1.f1.filesize = strlen((const char *)mbed_redirect_file);
-    dir1.f2.filesize = strlen((const char *)details_file);
+    dir1.f2.filesize = details_length();
     // patch fs entries (fat sizes and all blank regions)
-    fs[1].length = sizeof(fat) * mbr.logical_sectors_per_fat;
+    fs[1].length = sizeof(file_allocation_table_t) * mbr.logical_sectors_per_fat;
     fs[2].length = fs[1].length;
     fs[6].length = sizeof(blank_reigon)*(mbr.sectors_per_cluster - 1);
     fs[8].length = sizeof(blank_reigon)*(mbr.sectors_per_cluster - 1);
+    fs[10].length = sizeof(blank_reigon)*(mbr.sectors_per_cluster - 1);
+    fs[12].length = sizeof(blank_reigon)*(mbr.sectors_per_cluster - 1);
+    // index the blocks of the known area. Only the first block of an entry holds data
+    memset(sector_map, VFS_ZERO_SECTOR, sizeof(sector_map));
+    for (i = 0; fs[i].length != 0; i++) {
+        if ((block < VFS_INDEXED_SECTORS) && (fs[i].sect != 0) && (fs[i].sect != blank_reigon)) {
+            sector_map[block] = i;
+        }
+        fs_data_length[i] = (fs[i].length < mbr.bytes_per_sector) ? fs[i].length : mbr.bytes_per_sector;
+        block += fs[i].length / mbr.bytes_per_sector;
+    }
+    // the html file comes right after the root directory
+    html_block = mbr.reserved_logical_sectors + (mbr.logical_sectors_per_fat * mbr.num_fats) 
+        + ((mbr.max_root_dir_entries * sizeof(FatDirectoryEntry_t)) / mbr.bytes_per_sector);
+    details_block = html_block + mbr.sectors_per_cluster;
+    program_block = html_block + (3 * mbr.sectors_per_cluster);
+    flash_bin_block = html_block + ((VFS_FLASH_BIN_CLUSTER - 2) * mbr.sectors_per_cluster);
+}
+
+void virtual_fs_read_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks)
+{
+    uint32_t length = 0;
+    uint8_t idx = VFS_ZERO_SECTOR;
+    
+    while (num_of_blocks--) {
+        idx = (block < VFS_INDEXED_SECTORS) ? sector_map[block] : VFS_ZERO_SECTOR;
+        if (block == html_block) {
+            // runtime content, generated straight into the transfer buffer
+            update_html_file(buf, mbr.bytes_per_sector);
+        }
+        else if (block == details_block) {
+            update_details_file(buf, mbr.bytes_per_sector);
+        }
+        else if (block == program_block) {
+            update_program_file(buf, mbr.bytes_per_sector);
+        }
+        else if ((block >= mbr.reserved_logical_sectors) && 
+                 (block < (mbr.reserved_logical_sectors + (mbr.num_fats * mbr.logical_sectors_per_fat)))) {
+            fat_read_sect((block - mbr.reserved_logical_sectors) % mbr.logical_sectors_per_fat, buf);
+        }
+        else if ((block >= flash_bin_block) && 
+                 (block < (flash_bin_block + ((flash_bin_size + mbr.bytes_per_sector - 1) / mbr.bytes_per_sector)))) {
+            flash_bin_read_sect((block - flash_bin_block) * mbr.bytes_per_sector, buf);
+        }
+        else if (VFS_ZERO_SECTOR == idx) {
+            memset(buf, 0, mbr.bytes_per_sector);
+        }
+        else {
+            length = fs_data_length[idx];
+            memcpy(buf, fs[idx].sect, length);
+            memset(buf + length, 0, mbr.bytes_per_sector - length);
+        }
+        buf += mbr.bytes_per_sector;
+        block++;
+    }
 }
 
 file_transfer_state_t file_transfer_state;
 
 void reset_file_transfer_state(void)
 {
-    static const file_transfer_state_t default_transfer_state = {0,0,0,0,0,0,UNKNOWN};
+    static const file_transfer_state_t default_transfer_state = {0,0,0,0,0,0,UNKNOWN,0,0,0,0,0,0};
     file_transfer_state = default_transfer_state;
 }
@@ -53,6 +53,11 @@ uint8_t validate_hexfile(uint8_t *buf)
     return 0;
 }
 
+uint8_t validate_compressed_image(uint8_t *buf)
+{
+    return 0;
+}
+
 target_flash_status_t target_flash_init(extension_t ext)
 {
     PORT_SWD_SETUP();
@@ -72,6 +77,12 @@ target_flash_status_t target_flash_init(extension_t ext)
     return TARGET_OK;
 }
 
+target_flash_status_t target_flash_uninit(void)
+{
+    // every page is programmed as it arrives, nothing is left waiting
+    return TARGET_OK;
+}
+
 target_flash_status_t target_flash_erase_sector(unsigned int sector)
 {
     if (!swd_flash_syscall_exec(&flash.sys_call_param, flash.erase_sector, sector * target_device.sector_size, 0, 0, 0)) {
@@ -90,6 +101,20 @@ target_flash_status_t target_flash_erase_chip(void)
     return TARGET_OK;
 }
 
+uint8_t target_flash_scratch(uint32_t *buffer, uint32_t *stack)
+{
+    // the program buffer and the algorithm stack are free between programming runs
+    *buffer = flash.program_buffer;
+    *stack = flash.sys_call_param.stack_pointer;
+    return (0 != *buffer);
+}
+
+uint8_t target_flash_crc(uint32_t addr, uint32_t size, uint32_t *value)
+{
+    // no CRC code to load on these targets, the probe reads the region instead
+    return 0;
+}
+
 target_flash_status_t target_flash_program_page(uint32_t addr, uint8_t * buf, uint32_t size)
 {
     uint32_t bytes_written = 0;
@@ -74,8 +74,8 @@ static DAP_STATE dap_state;
 static uint32_t select_state;
 static volatile uint32_t swd_init_debug_flag = 0;
 
-static uint8_t swd_read_core_register(uint32_t n, uint32_t *val, uint32_t cmd);
-static uint8_t swd_write_core_register(uint32_t n, uint32_t val, uint32_t cmd);
+static uint8_t ca_read_core_register(uint32_t n, uint32_t *val, uint32_t cmd);
+static uint8_t ca_write_core_register(uint32_t n, uint32_t val, uint32_t cmd);
 /* Add static functions */
 static uint8_t swd_restart_req(void);
 static uint8_t swd_enable_debug(void);
@@ -512,7 +512,7 @@ static uint8_t swd_write_debug_state(DEBUG_STATE *state) {
     for (i = 0; i < 4; i++) {
         work_cmd = 0;
         work_cmd = (CMD_MRC | (i << 12));
-        if (!swd_write_core_register(i, state->r[i], work_cmd)) {
+        if (!ca_write_core_register(i, state->r[i], work_cmd)) {
             return 0;
         }
     }
@@ -520,7 +520,7 @@ static uint8_t swd_write_debug_state(DEBUG_STATE *state) {
     // R9
     work_cmd = 0;
     work_cmd = (CMD_MRC | (9 << 12));
-    if (!swd_write_core_register(9, state->r[9], work_cmd)) {
+    if (!ca_write_core_register(9, state->r[9], work_cmd)) {
         return 0;
     }
 
@@ -528,7 +528,7 @@ static uint8_t swd_write_debug_state(DEBUG_STATE *state) {
     for (i=13; i<15; i++) {
         work_cmd = 0;
         work_cmd = (CMD_MRC | (i << 12));
-        if (!swd_write_core_register(i, state->r[i], work_cmd)) {
+        if (!ca_write_core_register(i, state->r[i], work_cmd)) {
             return 0;
         }
     }
@@ -538,7 +538,7 @@ static uint8_t swd_write_debug_state(DEBUG_STATE *state) {
     /* write PSR (write r6) */
     work_cmd = 0;
     work_cmd = (CMD_MRC | (6 << 12));
-    if (!swd_write_core_register(0, state->xpsr, work_cmd)) {
+    if (!ca_write_core_register(0, state->xpsr, work_cmd)) {
         return 0;
     }
     /* MSR (PSR <- r6) */
@@ -552,7 +552,7 @@ static uint8_t swd_write_debug_state(DEBUG_STATE *state) {
     /* MRC R7 */
     work_cmd = 0;
     work_cmd = (CMD_MRC | (7 << 12));
-    if (!swd_write_core_register(7, state->r[15], work_cmd)) {
+    if (!ca_write_core_register(7, state->r[15], work_cmd)) {
         return 0;
     }
     /* MOV R15, R7 */
@@ -631,7 +631,7 @@ static uint8_t swd_enable_debug(void) {
     return 1;
 }
 
-static uint8_t swd_read_core_register(uint32_t n, uint32_t *val, uint32_t cmd) {
+static uint8_t ca_read_core_register(uint32_t n, uint32_t *val, uint32_t cmd) {
     if (!swd_write_word(DBGITR, cmd)) {
         return 0;
     }
@@ -643,7 +643,7 @@ static uint8_t swd_read_core_register(uint32_t n, uint32_t *val, uint32_t cmd) {
     return 1;
 }
 
-static uint8_t swd_write_core_register(uint32_t n, uint32_t val, uint32_t cmd) {
+static uint8_t ca_write_core_register(uint32_t n, uint32_t val, uint32_t cmd) {
     if (!swd_write_word(DBGDTRRX, val)){
         return 0;
     }
@@ -673,13 +673,13 @@ uint8_t swd_is_semihost_event(uint32_t *r0, uint32_t *r1) {
     // Read r0 and r1
     work_cmd = 0;
     work_cmd = (CMD_MCR | (0 << 12));
-    if (!swd_read_core_register(0, r0, work_cmd)) {
+    if (!ca_read_core_register(0, r0, work_cmd)) {
         return 0;
     }
 
     work_cmd = 0;
     work_cmd = (CMD_MCR | (1 << 12));
-    if (!swd_read_core_register(1, r1, work_cmd)) {
+    if (!ca_read_core_register(1, r1, work_cmd)) {
         return 0;
     }
 
@@ -711,7 +711,7 @@ uint8_t swd_semihost_restart(uint32_t r0) {
     // Update r0
     work_cmd = 0;
     work_cmd = (CMD_MRC | (0 << 12));
-    if (!swd_write_core_register(0, r0, work_cmd)) {
+    if (!ca_write_core_register(0, r0, work_cmd)) {
             return 0;
         }
 
@@ -720,14 +720,14 @@ uint8_t swd_semihost_restart(uint32_t r0) {
     /* check PC */
     work_cmd = 0;
     work_cmd = (CMD_MCR | (15 << 12));
-    if (!swd_read_core_register(15, &pc, work_cmd)) {
+    if (!ca_read_core_register(15, &pc, work_cmd)) {
         return 0;
     }
 
     /* MRC R7 */
     work_cmd = 0;
     work_cmd = (CMD_MRC | (7 << 12));
-    if (!swd_write_core_register(7, pc + 4, work_cmd)) {
+    if (!ca_write_core_register(7, pc + 4, work_cmd)) {
         return 0;
     }
     /* MOV R15, R7 */
@@ -776,7 +776,7 @@ uint8_t swd_flash_syscall_exec(const FLASH_SYSCALL *sysCallParam, uint32_t entry
     /* r0 read */
     work_cmd = 0;
     work_cmd = (CMD_MCR | (0 << 12));
-    if (!swd_read_core_register(0, &state.r[0], work_cmd)) {
+    if (!ca_read_core_register(0, &state.r[0], work_cmd)) {
         return 0;
     }
 
@@ -362,6 +362,19 @@ extern void      _os_resume (U32 p, U32 sleep_time)                    __SVC_0;
 extern void      _os_tsk_lock (U32 p)                                  __SVC_0;
 extern void      _os_tsk_unlock (U32 p)                                __SVC_0;
 
+/* Task Switch Trace (OS_TRACE in RTX_Config.c) */
+extern U32       rt_trace_read  (U32 seq, U32 *buf, U32 max);
+extern OS_RESULT rt_trace_task  (U32 index, U32 *info);
+extern void      rt_trace_clear (void);
+
+#define os_trace_read(seq,buf,max) _os_trace_read((U32)rt_trace_read,seq,buf,max)
+#define os_trace_task(index,info)  _os_trace_task((U32)rt_trace_task,index,info)
+#define os_trace_clear()           _os_trace_clear((U32)rt_trace_clear)
+
+extern U32       _os_trace_read (U32 p, U32 seq, U32 *buf, U32 max)    __SVC_0;
+extern OS_RESULT _os_trace_task (U32 p, U32 index, U32 *info)          __SVC_0;
+extern void      _os_trace_clear (U32 p)                               __SVC_0;
+
 /* Fixed Memory Block Management Functions */
 extern int       _init_box (void *box_mem, U32 box_size, U32 blk_size);
 extern void     *_alloc_box (void *box_mem);
@@ -44,6 +44,8 @@ extern U16 const mp_tcb_size;
 extern U32 const mp_stk_size;
 extern U32 const *m_tmr;
 extern U16 const mp_tmr_size;
+extern U32 *const m_trace;
+extern U16 const os_trace_size;
 extern U8  const os_fifo_size;
 
 /* Functions */
@@ -89,6 +89,27 @@ void *os_active_TCB[OS_TASKCNT];
  U16 const mp_tmr_size = 0;
 #endif
 
+#ifndef OS_TRACE
+ #define OS_TRACE       0
+#endif
+#ifndef OS_TRACESZ
+ #define OS_TRACESZ     32
+#endif
+
+#if (OS_TRACE != 0)
+ #if (OS_TRACESZ & (OS_TRACESZ - 1))
+  #error "OS_TRACESZ must be a power of 2"
+ #endif
+ /* Task switch trace: header, run time and switch count per task (idle    */
+ /* first), then the ring of switches. Laid out in rt_System.c             */
+ static U32 os_trace_mem[4 + (OS_TASKCNT+1)*2 + OS_TRACESZ*2];
+ U32 *const m_trace = &os_trace_mem[0];
+ U16 const os_trace_size = OS_TRACESZ;
+#else
+ U32 *const m_trace = NULL;
+ U16 const os_trace_size = 0;
+#endif
+
 #ifndef __MICROLIB
  /* A memory space for arm standard library. */
  static U32    std_libspace[OS_TASKCNT][96/4];
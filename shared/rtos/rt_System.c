@@ -37,6 +37,14 @@ int os_tick_irqn;
  *      Local Variables
  *---------------------------------------------------------------------------*/
 
+/* Task switch trace layout in m_trace (see RTX_lib.c) */
+#define TRC_SEQ         0         /* Switches recorded since the last clear  */
+#define TRC_START       1         /* Time stamp of the last clear            */
+#define TRC_LAST        2         /* Time stamp of the last switch           */
+#define TRC_TSK         4         /* Run time, switches in for every task    */
+#define TRC_RING        (TRC_TSK + (os_maxtaskrun + 1) * 2)
+#define TRC_STK_FILL    0xCCCCCCCC
+
 static volatile BIT os_lock;
 static volatile BIT os_psh_flag;
 static          U8  pend_flags;
@@ -263,6 +271,143 @@ __weak void rt_stk_check (void) {
   }
 }
 
+/*--------------------------- rt_trace_time ---------------------------------*/
+
+static U32 rt_trace_time (void) {
+  /* Processor clock cycles from the system tick count and the SysTick timer */
+  U32 cnt  = NVIC_ST_CURRENT;
+  U32 tick = os_time;
+
+  if (NVIC_INT_CTRL & (1 << 26)) {
+    /* Timer reloaded but the tick is not counted yet */
+    cnt = NVIC_ST_CURRENT;
+    tick++;
+  }
+  return (tick * (os_trv + 1) + (os_trv - cnt));
+}
+
+
+/*--------------------------- rt_trace_idx ----------------------------------*/
+
+static __inline U32 rt_trace_idx (P_TCB p_TCB) {
+  /* Counter slot of a task, the idle demon uses slot 0 */
+  return ((p_TCB == &os_idle_TCB) ? 0 : p_TCB->task_id);
+}
+
+
+/*--------------------------- rt_trace_switch -------------------------------*/
+
+void rt_trace_switch (P_TCB p_new) {
+  /* Charge the running task and record the switch to "p_new". The exception */
+  /* number gives the cause: SVC = task call, PendSV = ISR, SysTick = tick    */
+  register U32 ipsr __asm("ipsr");
+  U32 now, *rec;
+
+  if (os_trace_size == 0 || os_tsk.run == NULL || os_tsk.run == p_new) {
+    return;
+  }
+  now = rt_trace_time ();
+  m_trace[TRC_TSK + rt_trace_idx (os_tsk.run) * 2] += now - m_trace[TRC_LAST];
+  m_trace[TRC_TSK + rt_trace_idx (p_new) * 2 + 1]++;
+  m_trace[TRC_LAST] = now;
+  rec = &m_trace[TRC_RING + (m_trace[TRC_SEQ] & (os_trace_size - 1)) * 2];
+  rec[0] = now;
+  rec[1] = os_tsk.run->task_id | (p_new->task_id << 8) | ((ipsr & 0x1FF) << 16);
+  m_trace[TRC_SEQ]++;
+}
+
+
+/*--------------------------- rt_trace_init_stack ---------------------------*/
+
+void rt_trace_init_stack (P_TCB p_TCB) {
+  /* Fill the unused stack of a new task to find the high water mark later */
+  U32 *stk;
+
+  if (os_trace_size == 0) {
+    return;
+  }
+  for (stk = &p_TCB->stack[1]; stk < (U32 *)p_TCB->tsk_stack; stk++) {
+    *stk = TRC_STK_FILL;
+  }
+}
+
+
+/*--------------------------- rt_trace_read ---------------------------------*/
+
+U32 rt_trace_read (U32 seq, U32 *buf, U32 max) {
+  /* Copy up to "max" switches starting at number "seq" or the oldest kept. */
+  /* buf[0] gets the number of the first one, buf[1] the current time and   */
+  /* buf[2] the time of the last clear. Two words per switch follow.        */
+  U32 cnt, idx;
+
+  buf[0] = seq;
+  buf[1] = rt_trace_time ();
+  buf[2] = 0;
+  if (os_trace_size == 0) {
+    return (0);
+  }
+  if ((m_trace[TRC_SEQ] - seq) > os_trace_size) {
+    /* Overwritten or not recorded yet */
+    seq = (m_trace[TRC_SEQ] > os_trace_size) ? (m_trace[TRC_SEQ] - os_trace_size) : 0;
+  }
+  buf[0] = seq;
+  buf[2] = m_trace[TRC_START];
+  for (cnt = 0; cnt < max && seq != m_trace[TRC_SEQ]; cnt++, seq++) {
+    idx = TRC_RING + (seq & (os_trace_size - 1)) * 2;
+    buf[3 + cnt*2] = m_trace[idx];
+    buf[4 + cnt*2] = m_trace[idx + 1];
+  }
+  return (cnt);
+}
+
+
+/*--------------------------- rt_trace_task ---------------------------------*/
+
+OS_RESULT rt_trace_task (U32 index, U32 *info) {
+  /* Counters of the task in slot "index" (0 = idle demon, else task id).    */
+  /* info[0] task id | prio << 8 | state << 16, info[1] stack size | stack  */
+  /* used << 16, info[2] entry address, info[3] run time, info[4] switches  */
+  P_TCB p_TCB;
+  U32 size, i;
+
+  if (os_trace_size == 0 || index > os_maxtaskrun) {
+    return (OS_R_NOK);
+  }
+  p_TCB = (index == 0) ? &os_idle_TCB : os_active_TCB[index-1];
+  if (p_TCB == NULL) {
+    return (OS_R_NOK);
+  }
+  size = p_TCB->priv_stack ? p_TCB->priv_stack : (U16)os_stackinfo;
+  for (i = 1; i < (size >> 2) && p_TCB->stack[i] == TRC_STK_FILL; i++);
+  info[0] = p_TCB->task_id | (p_TCB->prio << 8) | (p_TCB->state << 16);
+  info[1] = size | ((size - (i << 2)) << 16);
+  info[2] = (U32)p_TCB->ptask;
+  info[3] = m_trace[TRC_TSK + index * 2];
+  info[4] = m_trace[TRC_TSK + index * 2 + 1];
+  if (p_TCB == os_tsk.run) {
+    /* Still running, add the time since it was switched in */
+    info[3] += rt_trace_time () - m_trace[TRC_LAST];
+  }
+  return (OS_R_OK);
+}
+
+
+/*--------------------------- rt_trace_clear --------------------------------*/
+
+void rt_trace_clear (void) {
+  /* Restart the run time counters and the switch ring */
+  U32 i;
+
+  if (os_trace_size == 0) {
+    return;
+  }
+  for (i = 0; i < TRC_RING; i++) {
+    m_trace[i] = 0;
+  }
+  m_trace[TRC_START] = rt_trace_time ();
+  m_trace[TRC_LAST]  = m_trace[TRC_START];
+}
+
 /*----------------------------------------------------------------------------
  * end of file
  *---------------------------------------------------------------------------*/
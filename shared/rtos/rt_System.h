@@ -27,6 +27,8 @@ extern void rt_psh_req    (void);
 extern void rt_pop_req    (void);
 extern void rt_systick    (void);
 extern void rt_stk_check  (void);
+extern void rt_trace_switch     (P_TCB p_new);
+extern void rt_trace_init_stack (P_TCB p_TCB);
 
 /*----------------------------------------------------------------------------
  * end of file
@@ -73,6 +73,7 @@ static void rt_init_context (P_TCB p_TCB, U8 priority, FUNCP task_body) {
     p_TCB->stack = rt_alloc_box (mp_stk);
   }
   rt_init_stack (p_TCB, task_body);
+  rt_trace_init_stack (p_TCB);
 }
 
 
@@ -80,6 +81,7 @@ static void rt_init_context (P_TCB p_TCB, U8 priority, FUNCP task_body) {
 
 void rt_switch_req (P_TCB p_new) {
   /* Switch to next task (identified by "p_new"). */
+  rt_trace_switch (p_new);
   os_tsk.new   = p_new;
   p_new->state = RUNNING;
   DBG_TASK_SWITCH(p_new->task_id);
@@ -0,0 +1,72 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Add the integrity trailer checked by the bootloader before it starts an
+interface firmware image. The image is padded with 0xFF to the end of the
+application region of the bootloader and the last 12 bytes are the trailer:
+'ITRL', the size of the image and its CRC-32. The vector table is left alone,
+so LPC images keep the checksum tools/patch.py stores at offset 0x1C.
+
+    python add_image_trailer.py --target lpc11u35 interface.bin
+"""
+from struct import pack, unpack_from
+from optparse import OptionParser
+import zlib
+import sys
+
+TRAILER_MAGIC = 0x4C525449
+TRAILER_SIZE = 12
+
+# END_FLASH - START_APP_ADDRESS in bootloader/Common/inc/flash_hal.h
+REGION_SIZE = {
+    'lpc11u35': 0x10000 - 0x5000,
+    'k20dx128': 0x20000 - 0x5000,
+    'atsam3u2c': 0x20000 - 0x5000,
+}
+
+
+def add_trailer(data, region_size):
+    data = bytearray(data)
+    size = len(data)
+    if size > region_size - TRAILER_SIZE:
+        raise ValueError('image is %d bytes, only %d fit before the trailer' % (size, region_size - TRAILER_SIZE))
+    crc = zlib.crc32(bytes(data)) & 0xFFFFFFFF
+    data += bytearray([0xFF]) * (region_size - TRAILER_SIZE - size)
+    return bytes(data) + pack('<III', TRAILER_MAGIC, size, crc)
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog --target name image.bin [output.bin]')
+    parser.add_option('-t', '--target', choices=sorted(REGION_SIZE),
+                      help='bootloader the image is for (%s)' % ', '.join(sorted(REGION_SIZE)))
+    (options, args) = parser.parse_args()
+    if len(args) < 1:
+        parser.error('missing input image')
+    if options.target is None:
+        parser.error('missing --target')
+
+    src = args[0]
+    dst = args[1] if len(args) > 1 else src
+    with open(src, 'rb') as f:
+        data = f.read()
+    try:
+        out = add_trailer(data, REGION_SIZE[options.target])
+    except ValueError as e:
+        parser.error(str(e))
+    with open(dst, 'wb') as f:
+        f.write(out)
+    magic, size, crc = unpack_from('<III', out, len(out) - TRAILER_SIZE)
+    sys.stdout.write('%s: %d bytes, crc32 0x%08x\n' % (dst, size, crc))
@@ -0,0 +1,77 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Start or stop the gdb server of an interface firmware built with GDB_SERVER
+(CMSIS-DAP HID vendor command 0x87). While it runs the virtual COM port
+carries gdb remote protocol packets instead of the target UART:
+
+    python dap_gdb.py on
+    arm-none-eabi-gdb app.elf -ex "target extended-remote /dev/ttyACM0"
+    (gdb) load
+    (gdb) monitor reset
+    python dap_gdb.py off
+
+'load' programs the flash with the drag-and-drop flash algorithm, which
+erases the whole chip first, and leaves the core halted at the reset vector.
+'monitor reset' and 'monitor halt' are understood. Breakpoints use the FPB,
+on Cortex-M0/M3/M4 only below 0x20000000. Connecting a CMSIS-DAP debugger
+stops the server.
+
+Needs the hidapi python module (pip install hidapi).
+"""
+from optparse import OptionParser
+import sys
+
+ID_DAP_VENDOR7 = 0x87
+DAP_OK = 0x00
+
+
+class Probe(object):
+    def __init__(self, vid, pid, serial=None):
+        import hid
+        self.dev = hid.device()
+        self.dev.open(vid, pid, serial)
+
+    def command(self, data):
+        # report id 0 then a full DAP packet
+        self.dev.write([0] + list(bytearray(data)) + [0] * (64 - len(data)))
+        resp = bytearray(self.dev.read(64, 1000))
+        if len(resp) < 3 or resp[0] != data[0]:
+            raise IOError('no response to vendor command 0x%02x' % data[0])
+        return resp
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog [options] on|off')
+    parser.add_option('--vid', type='int', default=0x0d28, help='USB vendor id')
+    parser.add_option('--pid', type='int', default=0x0204, help='USB product id')
+    parser.add_option('--serial', help='serial number of the probe to use')
+    (options, args) = parser.parse_args()
+    if len(args) != 1 or args[0] not in ('on', 'off'):
+        parser.error('expected on or off')
+
+    try:
+        import hid
+    except ImportError:
+        sys.exit('the hidapi python module is needed (pip install hidapi)')
+    try:
+        probe = Probe(options.vid, options.pid, options.serial)
+        resp = probe.command([ID_DAP_VENDOR7, 1 if args[0] == 'on' else 0])
+        if resp[1] != DAP_OK:
+            sys.exit('gdb server not built into this firmware (GDB_SERVER) or a debugger is connected')
+        sys.stdout.write('gdb server %s\n' % ('running' if resp[2] else 'stopped'))
+    except IOError as e:
+        sys.exit(str(e))
@@ -0,0 +1,238 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Run the on-probe memory operations of the interface firmware (CMSIS-DAP HID
+vendor command 0x83) on a target whose debug port is already connected in SWD
+mode, for example by a debugger session or a previous DAP_Connect. The probe
+refuses them on a JTAG or unconnected port. DAP_TransferAbort stops a command
+part way, which then reports a failure.
+
+    python dap_mem.py fill 0x20000000 0x8000 0
+    python dap_mem.py fill 0x20000000 0x8000 0x20000000 --step 4
+    python dap_mem.py compare 0x20000000 0x8000 0x20000000 --step 4
+    python dap_mem.py search 0x00000000 0x40000 0x4d4f4353 --mask 0xffffffff
+    python dap_mem.py crc 0x00000000 --file image.bin
+    python dap_mem.py dump 0x00000000 0x40000 --file flash.bin
+
+Word i of the region stands for value + i * step. Large regions are split
+into --chunk sized commands so each one answers well within the HID timeout.
+'crc' (vendor command 0x84) has the probe read the region and compute its
+CRC-32, leaving the target running. --target has the target core compute it,
+which is faster but halts the core and overwrites its RAM. With --file the
+size is taken from the file and the CRC compared.
+'dump' (vendor command 0x85) reads the region as a run length coded stream
+and writes it to --file, or to stdout as hex. unpack() is the reference
+decoder of the stream.
+
+Needs the hidapi python module (pip install hidapi).
+"""
+from optparse import OptionParser
+from struct import pack, unpack_from
+import sys
+import zlib
+
+ID_DAP_VENDOR3 = 0x83
+ID_DAP_VENDOR4 = 0x84
+ID_DAP_VENDOR5 = 0x85
+DAP_OK = 0x00
+MEM_FILL = 0
+MEM_COMPARE = 1
+MEM_SEARCH = 2
+MEM_NONE = 0xffffffff
+CRC_USE_TARGET = 0x01
+ZREAD_CONTINUE = 0x01
+
+
+def unpack(stream):
+    """Decode the compressed read stream of vendor command 0x85"""
+    out = bytearray()
+    data = bytearray(stream)
+    i = 0
+    while i < len(data):
+        tok = data[i]
+        if tok < 0x80:
+            # literal bytes
+            out += data[i + 1:i + 2 + tok]
+            i += 2 + tok
+        elif tok < 0xc0:
+            out += bytearray([data[i + 1]]) * ((tok & 0x3f) + 3)
+            i += 2
+        else:
+            count = (((tok & 0x1f) << 8) | data[i + 1]) + 1
+            out += bytearray([0x00 if tok < 0xe0 else 0xff]) * count
+            i += 2
+    return out
+
+
+class Probe(object):
+    def __init__(self, vid, pid, serial=None):
+        import hid
+        self.dev = hid.device()
+        self.dev.open(vid, pid, serial)
+
+    def command(self, data, timeout=5000):
+        # report id 0 then a full DAP packet
+        self.dev.write([0] + list(bytearray(data)) + [0] * (64 - len(data)))
+        resp = bytearray(self.dev.read(64, timeout))
+        if len(resp) < 2 or resp[0] != data[0]:
+            raise IOError('no response to vendor command 0x%02x' % data[0])
+        return resp
+
+
+class Memory(object):
+    def __init__(self, probe, chunk):
+        self.probe = probe
+        self.chunk = chunk
+
+    def run(self, op, addr, size, value, arg):
+        resp = self.probe.command(bytearray([ID_DAP_VENDOR3, op]) + pack('<IIII', addr, size, value, arg))
+        done = unpack_from('<I', resp, 2)[0]
+        if resp[1] != DAP_OK:
+            raise IOError('memory access failed at 0x%08x' % (addr + done))
+        return resp, done
+
+    def pieces(self, addr, size):
+        while size:
+            n = min(size, self.chunk)
+            yield addr, n
+            addr += n
+            size -= n
+
+    def fill(self, addr, size, value, step):
+        for a, n in self.pieces(addr, size):
+            self.run(MEM_FILL, a, n, (value + (a - addr) // 4 * step) & 0xffffffff, step)
+
+    def compare(self, addr, size, value, step):
+        # total mismatching words, first address and the value read there
+        errors, first, found = 0, MEM_NONE, 0
+        for a, n in self.pieces(addr, size):
+            resp, done = self.run(MEM_COMPARE, a, n, (value + (a - addr) // 4 * step) & 0xffffffff, step)
+            count, where, read = unpack_from('<III', resp, 6)
+            if count and not errors:
+                first, found = where, read
+            errors += count
+        return errors, first, found
+
+    def search(self, addr, size, value, mask):
+        for a, n in self.pieces(addr, size):
+            resp, done = self.run(MEM_SEARCH, a, n, value, mask)
+            where = unpack_from('<I', resp, 6)[0]
+            if where != MEM_NONE:
+                return where
+        return None
+
+    def crc(self, addr, size, use_target=False):
+        # CRC-32 as zlib.crc32 and whether the target core computed all of it
+        value, on_target = 0, use_target
+        for a, n in self.pieces(addr, size):
+            resp = self.probe.command(bytearray([ID_DAP_VENDOR4, CRC_USE_TARGET if use_target else 0]) +
+                                      pack('<III', a, n, value))
+            if resp[1] != DAP_OK:
+                raise IOError('memory access failed in 0x%08x..0x%08x' % (a, a + n))
+            on_target = on_target and resp[2] == 1
+            value = unpack_from('<I', resp, 3)[0]
+        return value, on_target
+
+    def dump(self, addr, size):
+        # the stream covers as much of the region as fits in one response
+        data = bytearray()
+        flags = 0
+        while len(data) < size:
+            resp = self.probe.command(bytearray([ID_DAP_VENDOR5, flags]) +
+                                      pack('<II', addr + len(data), size - len(data)))
+            length, done = resp[2], unpack_from('<I', resp, 3)[0]
+            chunk = unpack(resp[7:7 + length])
+            if len(chunk) != done:
+                raise IOError('bad stream at 0x%08x' % (addr + len(data)))
+            data += chunk
+            if resp[1] != DAP_OK:
+                raise IOError('memory access failed at 0x%08x' % (addr + len(data)))
+            flags = ZREAD_CONTINUE
+        return data
+
+
+def number(text):
+    return int(text, 0)
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog [options] fill|compare|search address size value\n'
+                                '       %prog [options] crc address size|--file image\n'
+                                '       %prog [options] dump address size [--file output]')
+    parser.add_option('--vid', type='int', default=0x0d28, help='USB vendor id')
+    parser.add_option('--pid', type='int', default=0x0204, help='USB product id')
+    parser.add_option('--serial', help='serial number of the probe to use')
+    parser.add_option('--step', default='0', help='added to the value for every word (fill, compare)')
+    parser.add_option('--mask', default='0xffffffff', help='bits of every word to match (search)')
+    parser.add_option('--chunk', default='0x10000', help='bytes per command')
+    parser.add_option('--file', help='image to compare the CRC with (crc) or output file (dump)')
+    parser.add_option('--target', action='store_true', default=False,
+                      help='compute the CRC on the target, halting it and overwriting its RAM (crc)')
+    (options, args) = parser.parse_args()
+    if args and args[0] == 'dump':
+        if len(args) != 3:
+            parser.error('expected dump then address and size')
+        addr, size = [number(a) for a in args[1:]]
+    elif args and args[0] == 'crc':
+        expected = None
+        if options.file:
+            with open(options.file, 'rb') as f:
+                data = f.read()
+            args.append(str(len(data)))
+            expected = zlib.crc32(data) & 0xffffffff
+        if len(args) != 3:
+            parser.error('expected crc then address and size or --file')
+        addr, size = [number(a) for a in args[1:]]
+    else:
+        if len(args) != 4 or args[0] not in ('fill', 'compare', 'search'):
+            parser.error('expected fill, compare, search or crc then address, size and value')
+        addr, size, value = [number(a) for a in args[1:]]
+        if (addr | size) & 3:
+            parser.error('address and size must be word aligned')
+
+    try:
+        import hid
+    except ImportError:
+        sys.exit('the hidapi python module is needed (pip install hidapi)')
+    try:
+        mem = Memory(Probe(options.vid, options.pid, options.serial), number(options.chunk) & ~3)
+        if args[0] == 'dump':
+            data = mem.dump(addr, size)
+            if options.file:
+                with open(options.file, 'wb') as f:
+                    f.write(data)
+            else:
+                for i in range(0, len(data), 16):
+                    sys.stdout.write('%08x  %s\n' % (addr + i, ' '.join('%02x' % b for b in data[i:i + 16])))
+        elif args[0] == 'crc':
+            value, on_target = mem.crc(addr, size, options.target)
+            sys.stdout.write('0x%08x (%s)\n' % (value, 'target' if on_target else 'probe'))
+            if expected is not None and value != expected:
+                sys.exit('does not match %s (0x%08x)' % (options.file, expected))
+        elif args[0] == 'fill':
+            mem.fill(addr, size, value, number(options.step))
+        elif args[0] == 'compare':
+            errors, first, read = mem.compare(addr, size, value, number(options.step))
+            if errors:
+                sys.exit('%d words differ, first at 0x%08x (read 0x%08x)' % (errors, first, read))
+            sys.stdout.write('match\n')
+        else:
+            where = mem.search(addr, size, value, number(options.mask))
+            if where is None:
+                sys.exit('not found')
+            sys.stdout.write('0x%08x\n' % where)
+    except IOError as e:
+        sys.exit(str(e))
@@ -98,10 +98,12 @@ class FlashInfo(object):
 
 def gen_flash_algo():
     if len(sys.argv) < 2:
-        print "usage: >python flash_algo_gen.py <abs_path_w_elf_name>"
+        print "usage: >python flash_algo_gen.py <abs_path_w_elf_name> [target_ram_size]"
         sys.exit()
         
     ALGO_ELF_PATH_NAME = sys.argv[1]
+    # RAM above the program buffer can hold several pages for a ProgramPages call
+    RAM_SIZE = int(sys.argv[2], 0) if len(sys.argv) > 2 else 0
     ALGO_ELF_PATH, ALGO_ELF_NAME = os.path.split(ALGO_ELF_PATH_NAME)
     DEV_INFO_PATH = join(ALGO_ELF_PATH, "DevDscr")
     ALGO_BIN_PATH = join(ALGO_ELF_PATH, "PrgCode")
@@ -149,6 +151,7 @@ const uint32_t flash_algorithm_blob[] = {
         res.write("""
 static const TARGET_FLASH flash_algorithm_struct = {
 """)
+        program_pages = 0
         for line in stdout.splitlines():
             t = line.strip().split()
             if len(t) < 5: continue
@@ -158,6 +161,10 @@ static const TARGET_FLASH flash_algorithm_struct = {
                 addr = ALGO_START + ALGO_OFFSET + int(loc, 16)
                 res.write("    0x%08X, // %s\n" % (addr,  name))
 
+            # optional entry that programs consecutive pages in one call
+            if name == 'ProgramPages':
+                program_pages = ALGO_START + ALGO_OFFSET + int(loc, 16)
+
             if name == '$d.realdata':
                 if sec == '2':
                     prg_data = int(loc, 16)
@@ -171,11 +178,20 @@ static const TARGET_FLASH flash_algorithm_struct = {
         res.write("        0x%08X + 0x%X + 0x%X,  // static base register value (image start + header + static base offset)\n" % (ALGO_START, ALGO_OFFSET, prg_data))
         res.write("        0x%08X // initial stack pointer\n" % (ALGO_START+2048))
         res.write("    },\n\n")
-        res.write("    0x%08X, // flash_buffer, any valid RAM location with > 512 bytes of working room and proper alignment\n" % (ALGO_START+2048+256))
+        flash_buffer = ALGO_START+2048+256
+        res.write("    0x%08X, // flash_buffer, any valid RAM location with > 512 bytes of working room and proper alignment\n" % flash_buffer)
         res.write("    0x%08X, // algo_start, start of RAM\n" % ALGO_START)
         res.write("    sizeof(flash_algorithm_blob), // algo_size, size of array above\n")
         res.write("    flash_algorithm, // image, flash algo instruction array\n")
-        res.write("    512              // ram_to_flash_bytes_to_be_written\n")
+        res.write("    512,             // ram_to_flash_bytes_to_be_written\n")
+        max_program_size = 0
+        if program_pages and (ALGO_START + RAM_SIZE > flash_buffer):
+            max_program_size = ((ALGO_START + RAM_SIZE - flash_buffer) // 512) * 512
+        if max_program_size <= 512:
+            program_pages = 0
+            max_program_size = 0
+        res.write("    0x%08X, // program_pages, ProgramPages entry or 0 for one page per call\n" % program_pages)
+        res.write("    0x%X         // max_program_size, bytes of flash_buffer one program_pages call may use\n" % max_program_size)
         res.write("};\n\n")
 
 
@@ -0,0 +1,128 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Compress a .bin image into the .hsz container understood by the interface
+firmware. Dragging the .hsz file onto the MSC drive programs the same image
+with fewer bytes on the wire.
+
+Container: 'HSZ', version, window bits, lookahead bits, 2 reserved bytes,
+uncompressed size (uint32 LE), 4 reserved bytes, then the heatshrink
+bitstream. The window must not be larger than HEATSHRINK_MAX_WINDOW_BITS
+in the firmware (8 by default).
+"""
+from struct import pack
+from optparse import OptionParser
+import sys
+
+HSZ_VERSION = 1
+MIN_MATCH = 2
+MAX_CANDIDATES = 64
+
+
+class BitWriter(object):
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.cnt = 0
+
+    def write(self, value, bits):
+        for i in range(bits - 1, -1, -1):
+            self.acc = (self.acc << 1) | ((value >> i) & 1)
+            self.cnt += 1
+            if self.cnt == 8:
+                self.out.append(self.acc)
+                self.acc = 0
+                self.cnt = 0
+
+    def flush(self):
+        if self.cnt:
+            self.out.append(self.acc << (8 - self.cnt))
+            self.acc = 0
+            self.cnt = 0
+        return self.out
+
+
+def compress(data, window_bits, lookahead_bits):
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    bw = BitWriter()
+    # most recent positions for each 2 byte prefix, newest last
+    prefixes = {}
+    i = 0
+    n = len(data)
+    while i < n:
+        best_len = 0
+        best_off = 0
+        if i + MIN_MATCH <= n:
+            key = bytes(data[i:i + MIN_MATCH])
+            for j in reversed(prefixes.get(key, [])[-MAX_CANDIDATES:]):
+                off = i - j
+                if off > window:
+                    break
+                k = MIN_MATCH
+                limit = min(max_len, n - i)
+                while k < limit and data[j + k] == data[i + k]:
+                    k += 1
+                if k > best_len:
+                    best_len = k
+                    best_off = off
+                    if k == limit:
+                        break
+        # a back-reference costs 1 + window_bits + lookahead_bits bits
+        if best_len * 9 > 1 + window_bits + lookahead_bits:
+            bw.write(0, 1)
+            bw.write(best_off - 1, window_bits)
+            bw.write(best_len - 1, lookahead_bits)
+            step = best_len
+        else:
+            bw.write(1, 1)
+            bw.write(data[i], 8)
+            step = 1
+        for p in range(i, i + step):
+            if p + MIN_MATCH <= n:
+                chain = prefixes.setdefault(bytes(data[p:p + MIN_MATCH]), [])
+                chain.append(p)
+                if len(chain) > 2 * MAX_CANDIDATES:
+                    del chain[:MAX_CANDIDATES]
+        i += step
+    return bw.flush()
+
+
+def pack_image(data, window_bits, lookahead_bits):
+    header = b'HSZ' + pack('<BBBBBIxxxx', HSZ_VERSION, window_bits, lookahead_bits, 0, 0, len(data))
+    return header + bytes(compress(data, window_bits, lookahead_bits))
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog [options] image.bin [image.hsz]')
+    parser.add_option('-w', '--window', type='int', default=8, help='window size in bits (4-8)')
+    parser.add_option('-l', '--lookahead', type='int', default=4, help='lookahead size in bits (3 to window-1)')
+    (options, args) = parser.parse_args()
+    if len(args) < 1:
+        parser.error('missing input image')
+    if not (4 <= options.window <= 8) or not (3 <= options.lookahead < options.window):
+        parser.error('unsupported window/lookahead combination')
+
+    src = args[0]
+    dst = args[1] if len(args) > 1 else src.rsplit('.', 1)[0] + '.hsz'
+    with open(src, 'rb') as f:
+        data = bytearray(f.read())
+    if not data:
+        parser.error('input image is empty')
+    packed = pack_image(data, options.window, options.lookahead)
+    with open(dst, 'wb') as f:
+        f.write(packed)
+    sys.stdout.write('%s: %d -> %d bytes (%.1f%%)\n' % (dst, len(data), len(packed), 100.0 * len(packed) / len(data)))
@@ -0,0 +1,78 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Build a .pat file that updates the interface firmware installed on a probe
+(base.bin) to a new release (new.bin). Copy it onto the bootloader drive like
+a .bin file. Only the 1KB blocks that differ are transferred and only the
+flash pages that contain them are reprogrammed. The bootloader refuses the
+patch unless the installed image matches base.bin exactly.
+
+Header (little endian): 'DPAT', version, log2 block size, 2 reserved bytes,
+base size, base CRC-32, new size, new CRC-32, block count, 4 reserved bytes.
+Each record is a uint32 block index followed by the new block contents.
+"""
+from struct import pack
+from optparse import OptionParser
+import zlib
+import sys
+
+PATCH_VERSION = 1
+BLOCK_BITS = 10
+BLOCK_SIZE = 1 << BLOCK_BITS
+
+
+def crc32(data):
+    return zlib.crc32(bytes(data)) & 0xFFFFFFFF
+
+
+def make_patch(base, new):
+    # the bootloader fills anything past the installed image with 0xff
+    padded_len = (len(new) + BLOCK_SIZE - 1) // BLOCK_SIZE * BLOCK_SIZE
+    new_padded = bytearray(new) + bytearray(b'\xff' * (padded_len - len(new)))
+    base_padded = bytearray(base[:padded_len])
+    base_padded += bytearray(b'\xff' * (padded_len - len(base_padded)))
+    records = bytearray()
+    count = 0
+    for block in range(padded_len // BLOCK_SIZE):
+        start = block * BLOCK_SIZE
+        chunk = new_padded[start:start + BLOCK_SIZE]
+        if chunk != base_padded[start:start + BLOCK_SIZE]:
+            records += pack('<I', block) + chunk
+            count += 1
+    header = b'DPAT' + pack('<BBBBIIIIIxxxx', PATCH_VERSION, BLOCK_BITS, 0, 0,
+                            len(base), crc32(base), len(new), crc32(new), count)
+    return header + bytes(records), count
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog base.bin new.bin [update.pat]')
+    (options, args) = parser.parse_args()
+    if len(args) < 2:
+        parser.error('need the installed and the new image')
+
+    with open(args[0], 'rb') as f:
+        base = bytearray(f.read())
+    with open(args[1], 'rb') as f:
+        new = bytearray(f.read())
+    dst = args[2] if len(args) > 2 else args[1].rsplit('.', 1)[0] + '.pat'
+    if not new:
+        parser.error('new image is empty')
+    patch, count = make_patch(base, new)
+    if count == 0:
+        parser.error('images are identical, nothing to patch')
+    with open(dst, 'wb') as f:
+        f.write(patch)
+    sys.stdout.write('%s: %d of %d blocks changed, %d bytes\n' % (dst, count, (len(new) + BLOCK_SIZE - 1) // BLOCK_SIZE, len(patch)))
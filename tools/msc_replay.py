@@ -0,0 +1,320 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Drag-and-drop benchmark. usbd_user_msc.c and virtual_fs.c are built for the
+build machine on top of the SWD simulator (see swd_sim.py) and fed recorded
+mass storage traffic in the usblog.py text format:
+
+    python msc_replay.py --image app.bin win10.txt osx.txt ubuntu.txt
+
+Without captures the copy sequences of the windows, macos and linux profiles
+below are generated for the image (or a random one) and replayed. They follow
+the write order seen from each host but are no substitute for real captures:
+
+    windows  new dir entry and FAT chain first, data in 64KB writes, size last
+    macos    AppleDouble ._ file written ahead of the data, 32KB writes
+    linux    data first in 120KB writes of whole clusters, FAT and dir on sync
+
+For every capture the time to the eject, bytes programmed, pages programmed
+twice without an erase and the blocks dropped for arriving out of order are
+reported. --shuffle swaps neighbouring clusters of the image data to see how
+the firmware copes with reordering. --save keeps the generated captures. --phases adds the
+time per programming phase the firmware publishes in PROGRAM.TXT.
+"""
+from optparse import OptionParser
+from struct import pack, unpack
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+from swd_sim import SIM, COMMON, build
+
+REPLAY_SOURCES = [
+    os.path.join(SIM, 'msc_replay.c'),
+    os.path.join(COMMON, 'src', 'usbd_user_msc.c'),
+    os.path.join(COMMON, 'src', 'virtual_fs.c'),
+]
+
+# matches target_device in swd_sim/flash_blob.c
+RAM_END = 0x20010000
+FLASH_SIZE = 512 * 1024
+
+SCSI_TEST_UNIT_READY = 0x00
+SCSI_READ10 = 0x28
+SCSI_WRITE10 = 0x2A
+SCSI_SYNC_CACHE10 = 0x35
+PACKET = 64
+
+# profile_<phase>_ms lines of msc_replay.c, phases in program_profile.h order
+PHASES = ['total', 'reset', 'algo', 'erase', 'data', 'program', 'verify', 'usb']
+
+PROFILES = {
+    # name: (blocks per WRITE10, metadata before data, whole clusters, AppleDouble file)
+    'windows': (128, True, False, False),
+    'macos': (64, True, False, True),
+    'linux': (240, False, True, False),
+}
+
+
+class Disc(object):
+    """Layout and metadata of the virtual drive, read through the firmware"""
+    def __init__(self, replay):
+        self.replay = replay
+        boot = self.read(0, 1)[0]
+        (self.bytes_per_sector, self.sectors_per_cluster, self.reserved, self.num_fats,
+         self.root_entries, self.total_sectors, _, self.sectors_per_fat) = unpack('<HBHBHHBH', bytes(boot[11:24]))
+        self.fat_start = self.reserved
+        self.root_start = self.fat_start + self.num_fats * self.sectors_per_fat
+        self.root_blocks = self.root_entries * 32 // self.bytes_per_sector
+        self.data_start = self.root_start + self.root_blocks
+        self.fat = bytearray().join(self.read(self.fat_start, self.sectors_per_fat))
+        self.root = bytearray().join(self.read(self.root_start, self.root_blocks))
+
+    def read(self, block, count):
+        out = subprocess.check_output([self.replay, '-d', '%d:%d' % (block, count)])
+        return [bytearray(int(x, 16) for x in line.split()[1:]) for line in out.decode().splitlines()]
+
+    def cluster_bytes(self):
+        return self.sectors_per_cluster * self.bytes_per_sector
+
+    def cluster_block(self, cluster):
+        return self.data_start + (cluster - 2) * self.sectors_per_cluster
+
+    def fat_get(self, n):
+        i = n + n // 2
+        v = self.fat[i] | (self.fat[i + 1] << 8)
+        return (v >> 4) if n & 1 else (v & 0xfff)
+
+    def fat_set(self, n, value):
+        i = n + n // 2
+        if n & 1:
+            self.fat[i] = (self.fat[i] & 0x0f) | ((value << 4) & 0xf0)
+            self.fat[i + 1] = (value >> 4) & 0xff
+        else:
+            self.fat[i] = value & 0xff
+            self.fat[i + 1] = (self.fat[i + 1] & 0xf0) | ((value >> 8) & 0x0f)
+
+    def allocate(self, size):
+        """First fit chain for size bytes. Returns the first cluster"""
+        need = max(1, (size + self.cluster_bytes() - 1) // self.cluster_bytes())
+        chain = []
+        n = 2
+        while len(chain) < need:
+            if self.fat_get(n) == 0:
+                chain.append(n)
+            n += 1
+        for a, b in zip(chain, chain[1:] + [0xfff]):
+            self.fat_set(a, b)
+        return chain[0]
+
+    def add_entry(self, name, attributes):
+        """Free root dir slot for an 8.3 name. Returns its offset"""
+        for off in range(0, len(self.root), 32):
+            if self.root[off] in (0x00, 0xe5):
+                self.root[off:off + 32] = bytearray(32)
+                self.root[off:off + 12] = bytearray(name.encode()) + bytearray([attributes])
+                return off
+        raise Exception('root directory is full')
+
+    def set_entry(self, off, cluster, size):
+        self.root[off + 26:off + 32] = bytearray(pack('<HI', cluster, size))
+
+
+class Capture(object):
+    """Mass storage traffic in the usblog.py text format"""
+    def __init__(self, block_size):
+        self.block_size = block_size
+        self.lines = []
+        self.tag = 1
+
+    def packet(self, data):
+        self.lines.append(' '.join('%02X' % b for b in bytearray(data)))
+
+    def command(self, opcode, lba=0, blocks=0, data_in=False):
+        length = blocks * self.block_size
+        cb = bytearray([opcode, 0]) + bytearray(pack('>IBH', lba, 0, blocks)) + bytearray(7)
+        self.packet(b'USBC' + pack('<IIBBB', self.tag, length, 0x80 if data_in else 0, 0, 10) + bytes(cb))
+        return self.tag
+
+    def status(self, tag):
+        self.packet(b'USBS' + pack('<IIB', tag, 0, 0))
+        self.tag += 1
+
+    def write(self, lba, data):
+        tag = self.command(SCSI_WRITE10, lba, len(data) // self.block_size)
+        for i in range(0, len(data), PACKET):
+            self.packet(data[i:i + PACKET])
+        self.status(tag)
+
+    def read(self, lba, blocks):
+        self.status(self.command(SCSI_READ10, lba, blocks, True))
+
+    def simple(self, opcode):
+        self.status(self.command(opcode))
+
+    def text(self):
+        return '\n'.join(self.lines) + '\n'
+
+
+def write_metadata(cap, disc):
+    for i in range(disc.num_fats):
+        cap.write(disc.fat_start + i * disc.sectors_per_fat, bytes(disc.fat))
+    cap.write(disc.root_start, bytes(disc.root))
+
+
+def synthesize(profile, disc, image, shuffle, seed):
+    (chunk, meta_first, whole_clusters, apple_double) = PROFILES[profile]
+    bs = disc.bytes_per_sector
+    cap = Capture(bs)
+    rnd = random.Random(seed)
+
+    # mount: the host reads the boot sector, FATs and root dir
+    cap.simple(SCSI_TEST_UNIT_READY)
+    cap.read(0, 1)
+    cap.read(disc.fat_start, disc.sectors_per_fat)
+    cap.read(disc.root_start, disc.root_blocks)
+
+    if apple_double:
+        ad_entry = disc.add_entry('_IMAGE  BIN', 0x22)
+        ad_cluster = disc.allocate(4096)
+        disc.set_entry(ad_entry, ad_cluster, 4096)
+    entry = disc.add_entry('IMAGE   BIN', 0x20)
+    cluster = disc.allocate(len(image))
+    if meta_first:
+        # the entry is created empty and the chain allocated before any data
+        write_metadata(cap, disc)
+    if apple_double:
+        ad = pack('>II', 0x00051607, 0x00020000) + bytes(bytearray(4096 - 8))
+        cap.write(disc.cluster_block(ad_cluster), ad)
+
+    data = bytes(image)
+    pad = (len(data) + (disc.cluster_bytes() if whole_clusters else bs) - 1)
+    pad = pad - pad % (disc.cluster_bytes() if whole_clusters else bs)
+    data += bytes(bytearray(pad - len(data)))
+    # reorder whole clusters, then write runs of neighbouring ones up to chunk blocks
+    start = disc.cluster_block(cluster)
+    step = disc.cluster_bytes()
+    units = [(start + off // bs, data[off:off + step]) for off in range(0, len(data), step)]
+    for i in range(len(units) - 1):
+        if rnd.random() < shuffle:
+            units[i], units[i + 1] = units[i + 1], units[i]
+    lba, payload = units[0]
+    for next_lba, next_payload in units[1:]:
+        if (next_lba == lba + len(payload) // bs) and (len(payload) + len(next_payload) <= chunk * bs):
+            payload += next_payload
+        else:
+            cap.write(lba, payload)
+            lba, payload = next_lba, next_payload
+    cap.write(lba, payload)
+
+    disc.set_entry(entry, cluster, len(image))
+    write_metadata(cap, disc)
+    cap.simple(SCSI_SYNC_CACHE10)
+    return cap.text()
+
+
+def make_image(size, seed):
+    rnd = random.Random(seed)
+    image = bytearray(rnd.getrandbits(8) for _ in range(size))
+    vectors = [RAM_END, 0x101, 0x101, 0x101] + [0] * 12
+    image[0:64] = bytearray(pack('<16I', *vectors))
+    return image
+
+
+def run(replay, capture, image_path, options):
+    cmd = [replay, '-c', str(options.swclk), '-u', str(options.usb_kbps)]
+    if image_path:
+        cmd += ['-i', image_path]
+    proc = subprocess.Popen(cmd + [capture], stdout=subprocess.PIPE)
+    out = proc.communicate()[0].decode()
+    result = {}
+    for line in out.splitlines():
+        if ': ' in line:
+            key, value = line.split(': ', 1)
+            result[key] = value
+    if 'result' not in result:
+        sys.stdout.write(out)
+    return result
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog [options] [capture.txt ...]')
+    parser.add_option('--cc', default='gcc', help='host C compiler')
+    parser.add_option('-i', '--image', help='.bin the captures copy, checked against the target flash')
+    parser.add_option('-s', '--size', type='int', default=64 * 1024, help='size of the random image when none is given')
+    parser.add_option('-p', '--profile', action='append', help='generated profile(s) to run (%s)' % ', '.join(sorted(PROFILES)))
+    parser.add_option('--shuffle', type='float', default=0.0, help='chance of swapping neighbouring clusters of the image')
+    parser.add_option('--seed', type='int', default=1, help='seed of the random image and the shuffle')
+    parser.add_option('--swclk', type='int', default=4000000, help='SWCLK frequency in Hz')
+    parser.add_option('--usb-kbps', type='int', default=1000, help='USB bulk rate in KB/s')
+    parser.add_option('--one-page', action='store_true', default=False,
+                      help='build the flash algorithm without the program_pages entry')
+    parser.add_option('--save', help='directory to keep the generated captures in')
+    parser.add_option('--phases', action='store_true', default=False,
+                      help='show the PROGRAM.TXT breakdown of every capture')
+    (options, args) = parser.parse_args()
+
+    work = tempfile.mkdtemp(prefix='msc_replay')
+    replay = os.path.join(work, 'msc_replay' + ('.exe' if os.name == 'nt' else ''))
+    defines = ['SIM_PROGRAM_PAGES=0'] if options.one_page else []
+    if build(options.cc, replay, defines, REPLAY_SOURCES):
+        sys.exit('build failed')
+
+    image_path = options.image
+    if image_path:
+        with open(image_path, 'rb') as f:
+            image = bytearray(f.read())
+    else:
+        image = make_image(options.size, options.seed)
+        image_path = os.path.join(work, 'image.bin')
+        with open(image_path, 'wb') as f:
+            f.write(image)
+    if len(image) > FLASH_SIZE:
+        sys.exit('image is larger than the simulated flash')
+
+    captures = [(os.path.basename(a), a) for a in args]
+    if not captures:
+        for profile in options.profile or sorted(PROFILES):
+            if profile not in PROFILES:
+                parser.error('unknown profile %s' % profile)
+            path = os.path.join(options.save or work, profile + '.txt')
+            with open(path, 'w') as f:
+                f.write(synthesize(profile, Disc(replay), image, options.shuffle, options.seed))
+            captures.append((profile, path))
+
+    fail = 0
+    results = []
+    sys.stdout.write('%-14s %-9s %10s %9s %10s %9s %9s %8s\n' % ('capture', 'result', 'time ms', 'KB/s',
+                     'programmed', 'rewritten', 'dropped', 'verify'))
+    for name, path in captures:
+        r = run(replay, path, image_path, options)
+        ms = float(r.get('time_ms', 0))
+        rate = (len(image) / 1024.0) / (ms / 1000.0) if ms else 0
+        sys.stdout.write('%-14s %-9s %10.1f %9.1f %10s %9s %9s %8s\n' % (name, r.get('result', 'error'), ms, rate,
+                         r.get('bytes_programmed', '-'), r.get('pages_rewritten', '-'),
+                         r.get('out_of_order', '-'), r.get('verify', '-')))
+        if r.get('result') != 'ok' or r.get('verify') != 'ok':
+            fail = 1
+        results.append((name, r))
+    if options.phases:
+        sys.stdout.write('\n%-14s' % 'phase ms')
+        sys.stdout.write(''.join(' %9s' % p for p in PHASES) + '\n')
+        for name, r in results:
+            sys.stdout.write('%-14s' % name)
+            sys.stdout.write(''.join(' %9s' % r.get('profile_%s_ms' % p, '-') for p in PHASES) + '\n')
+    sys.exit(fail)
@@ -0,0 +1,204 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Read the RTX task switch trace of an interface firmware built with OS_TRACE
+(RTX_Config.c) over the CMSIS-DAP HID vendor command 0x82.
+
+    python rtx_trace.py --map interface.map tasks -t 5
+    python rtx_trace.py --map interface.map switches
+
+'tasks' samples the run time counters twice, --interval seconds apart, and
+prints the CPU load, switch rate and stack high water mark of every task.
+'switches' prints the switches kept in the ring with the time spent in the
+task switched out and the cause: a kernel call made by the task (SVC), an
+ISR posting an event (PendSV, the USB and UART interrupts end up here) or
+the system tick (delays and timeouts). --map resolves the task entry
+addresses with the symbol table of the Keil .map file. Times are processor
+clock cycles on the probe and wrap after 2^32 of them, so keep the interval
+below a few seconds on the faster parts.
+
+Needs the hidapi python module (pip install hidapi).
+"""
+from optparse import OptionParser
+from struct import pack, unpack_from
+import re
+import sys
+import time
+
+ID_DAP_VENDOR2 = 0x82
+DAP_OK = 0x00
+TRACE_INFO = 0
+TRACE_TASKS = 1
+TRACE_READ = 2
+TRACE_CLEAR = 3
+TASK_SIZE = 19
+RECORD_SIZE = 8
+
+STATES = ['inactive', 'ready', 'running', 'wait_dly', 'wait_itv', 'wait_or',
+          'wait_and', 'wait_sem', 'wait_mbx', 'wait_mut']
+CAUSES = {11: 'SVC', 14: 'PendSV', 15: 'SysTick'}
+IDLE_ID = 255
+
+
+class Probe(object):
+    def __init__(self, vid, pid, serial=None):
+        import hid
+        self.dev = hid.device()
+        self.dev.open(vid, pid, serial)
+
+    def command(self, data):
+        # report id 0 then a full DAP packet
+        self.dev.write([0] + list(bytearray(data)) + [0] * (64 - len(data)))
+        resp = bytearray(self.dev.read(64, 1000))
+        if len(resp) < 2 or resp[0] != ID_DAP_VENDOR2:
+            raise IOError('no response to the trace command')
+        if resp[1] != DAP_OK:
+            raise IOError('trace not built into this firmware (OS_TRACE)')
+        return resp
+
+
+class Trace(object):
+    def __init__(self, probe):
+        self.probe = probe
+        self.clock = self.info()[0]
+
+    def info(self):
+        # clock Hz, now, time of the last clear
+        return unpack_from('<III', self.probe.command([ID_DAP_VENDOR2, TRACE_INFO]), 2)
+
+    def us(self, cycles):
+        return cycles * 1000000.0 / self.clock
+
+    def clear(self):
+        self.probe.command([ID_DAP_VENDOR2, TRACE_CLEAR])
+
+    def tasks(self):
+        out = {}
+        slot = 0
+        while True:
+            resp = self.probe.command([ID_DAP_VENDOR2, TRACE_TASKS, slot])
+            slot, count = resp[2], resp[3]
+            for i in range(count):
+                off = 4 + i * TASK_SIZE
+                tid, prio, state, size, used, entry, run, switches = unpack_from('<BBBHHIII', resp, off)
+                out[tid] = dict(prio=prio, state=state, size=size, used=used, entry=entry,
+                                run=run, switches=switches)
+            if slot == 0:
+                return out
+
+    def switches(self):
+        records = []
+        seq = 0
+        while True:
+            resp = self.probe.command([ID_DAP_VENDOR2, TRACE_READ] + list(bytearray(pack('<I', seq))))
+            count = resp[2]
+            first, now = unpack_from('<II', resp, 3)
+            for i in range(count):
+                stamp, word = unpack_from('<II', resp, 11 + i * RECORD_SIZE)
+                records.append((first + i, stamp, word & 0xff, (word >> 8) & 0xff, (word >> 16) & 0x1ff))
+            if count == 0:
+                return records, now
+            seq = first + count
+
+
+def load_map(path):
+    # Image Symbol Table lines: name  0xaddress  Thumb Code  size  object
+    names = {}
+    sym = re.compile(r'^\s+(\w+)\s+0x([0-9a-fA-F]+)\s+Thumb Code')
+    with open(path) as f:
+        for line in f:
+            m = sym.match(line)
+            if m:
+                names[int(m.group(2), 16) & ~1] = m.group(1)
+    return names
+
+
+def task_name(tid, tasks, names):
+    if tid == IDLE_ID:
+        return 'idle'
+    t = tasks.get(tid)
+    if t is None:
+        return 'task %d' % tid
+    return names.get(t['entry'] & ~1, 'task %d @%08x' % (tid, t['entry']))
+
+
+def show_tasks(trace, names, interval):
+    before = trace.tasks()
+    t0 = trace.info()[1]
+    time.sleep(interval)
+    after = trace.tasks()
+    t1 = trace.info()[1]
+    window = (t1 - t0) & 0xffffffff
+    sys.stdout.write('%-4s %-24s %4s %-9s %7s %9s %11s\n' % ('id', 'task', 'prio', 'state', 'load %',
+                     'switch/s', 'stack used'))
+    for tid in sorted(after):
+        a = after[tid]
+        b = before.get(tid, a)
+        run = (a['run'] - b['run']) & 0xffffffff
+        sw = (a['switches'] - b['switches']) & 0xffffffff
+        load = 100.0 * run / window if window else 0
+        rate = sw / (trace.us(window) / 1000000.0) if window else 0
+        state = STATES[a['state']] if a['state'] < len(STATES) else str(a['state'])
+        sys.stdout.write('%-4s %-24s %4d %-9s %7.1f %9.1f %5d/%-5d\n' % (
+            tid if tid != IDLE_ID else '-', task_name(tid, after, names)[:24], a['prio'], state,
+            load, rate, a['used'], a['size']))
+
+
+def show_switches(trace, names):
+    tasks = trace.tasks()
+    records, now = trace.switches()
+    if not records:
+        sys.stdout.write('no switches recorded\n')
+        return
+    if records[0][0] != 0:
+        sys.stdout.write('(%d older switches overwritten)\n' % records[0][0])
+    sys.stdout.write('%8s %12s %10s  %-8s %-20s    %-20s\n' % ('#', 'time us', 'ran us', 'cause', 'from', 'to'))
+    prev = None
+    for seq, stamp, src, dst, cause in records:
+        ran = trace.us((stamp - prev) & 0xffffffff) if prev is not None else 0
+        sys.stdout.write('%8d %12.1f %10.1f  %-8s %-20s -> %-20s\n' % (
+            seq, trace.us(stamp), ran, CAUSES.get(cause, str(cause)),
+            task_name(src, tasks, names)[:20], task_name(dst, tasks, names)[:20]))
+        prev = stamp
+    sys.stdout.write('now %.1f us\n' % trace.us(now))
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog [options] tasks|switches|clear')
+    parser.add_option('--vid', type='int', default=0x0d28, help='USB vendor id')
+    parser.add_option('--pid', type='int', default=0x0204, help='USB product id')
+    parser.add_option('--serial', help='serial number of the probe to use')
+    parser.add_option('-m', '--map', help='Keil .map file of the firmware for task names')
+    parser.add_option('-t', '--interval', type='float', default=1.0, help='seconds between the task samples')
+    (options, args) = parser.parse_args()
+    if len(args) != 1 or args[0] not in ('tasks', 'switches', 'clear'):
+        parser.error('expected one of tasks, switches, clear')
+
+    names = load_map(options.map) if options.map else {}
+    try:
+        import hid
+    except ImportError:
+        sys.exit('the hidapi python module is needed (pip install hidapi)')
+    try:
+        trace = Trace(Probe(options.vid, options.pid, options.serial))
+        if args[0] == 'clear':
+            trace.clear()
+        elif args[0] == 'tasks':
+            show_tasks(trace, names, options.interval)
+        else:
+            show_switches(trace, names)
+    except IOError as e:
+        sys.exit(str(e))
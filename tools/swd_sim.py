@@ -0,0 +1,91 @@
+"""
+CMSIS-DAP Interface Firmware
+Copyright (c) 2009-2015 ARM Limited
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Build the SWD host stack (SW_DP.c, DAP.c, swd_host.c, target_flash.c) for the
+build machine against the simulated target in swd_sim/ and run the throughput
+benchmarks. Options after -- are passed to the simulator, e.g.
+
+    python swd_sim.py -- -c 10000000 -s 131072 -w 50
+
+Needs gcc (or clang with --cc). The reported times are simulated target time
+so they can be compared between builds to see the effect of a change. A
+TAR wrap (-t) below TARGET_AUTO_INCREMENT_PAGE_SIZE makes the memory test
+fail, as it would on such a target.
+"""
+from optparse import OptionParser
+import os
+import subprocess
+import sys
+import tempfile
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(TOOLS)
+SIM = os.path.join(TOOLS, 'swd_sim')
+COMMON = os.path.join(ROOT, 'interface', 'Common')
+
+SOURCES = [
+    os.path.join(SIM, 'swd_model.c'),
+    os.path.join(SIM, 'sim_port.c'),
+    os.path.join(SIM, 'flash_blob.c'),
+    os.path.join(COMMON, 'src', 'SW_DP.c'),
+    os.path.join(COMMON, 'src', 'DAP.c'),
+    os.path.join(COMMON, 'src', 'swd_host.c'),
+    os.path.join(COMMON, 'src', 'target_flash.c'),
+    os.path.join(COMMON, 'src', 'intelhex.c'),
+    os.path.join(COMMON, 'src', 'heatshrink.c'),
+    os.path.join(COMMON, 'src', 'crc.c'),
+]
+
+# the simulator headers come first so its DAP_config.h, RTL.h and flash_blob.h are used
+INCLUDES = [
+    SIM,
+    os.path.join(SIM, 'inc'),
+    os.path.join(COMMON, 'inc'),
+    os.path.join(ROOT, 'shared', 'cmsis'),
+]
+
+
+def build(cc, output, defines, sources):
+    """Compile sources on top of the SWD stack and the target model"""
+    # the FAT tables in virtual_fs.c zero fill their entries with {0}
+    cmd = [cc, '-O2', '-Wall', '-Wno-missing-braces', '-std=gnu99', '-o', output,
+           '-include', os.path.join(SIM, 'inc', 'sim_compat.h')]
+    cmd += ['-I' + i for i in INCLUDES]
+    cmd += ['-D' + d for d in defines]
+    cmd += sources + SOURCES
+    return subprocess.call(cmd)
+
+
+if __name__ == '__main__':
+    parser = OptionParser(usage='usage: %prog [options] [-- simulator options]')
+    parser.add_option('--cc', default='gcc', help='host C compiler')
+    parser.add_option('--one-page', action='store_true', default=False,
+                      help='build the flash algorithm without the program_pages entry')
+    parser.add_option('--verify', action='store_true', default=False,
+                      help='build target_flash.c with the read back verify')
+    parser.add_option('-o', '--output', help='keep the simulator executable at this path')
+    (options, args) = parser.parse_args()
+
+    defines = []
+    if options.one_page:
+        defines.append('SIM_PROGRAM_PAGES=0')
+    if options.verify:
+        defines.append('TARGET_FLASH_VERIFY=1')
+    output = options.output or os.path.join(tempfile.gettempdir(), 'swd_sim' + ('.exe' if os.name == 'nt' else ''))
+
+    if build(options.cc, output, defines, [os.path.join(SIM, 'sim_main.c')]):
+        sys.exit('build failed')
+    sys.exit(subprocess.call([output] + args))
@@ -0,0 +1,74 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Flash algorithm and device description of the simulated target. The model in
+//  swd_model.c recognises the entry points below and checks the image is in RAM
+
+#include "target_flash.h"
+#include "target_config.h"
+#include "flash_blob.h"
+
+#ifndef SIM_PROGRAM_PAGES
+#define SIM_PROGRAM_PAGES (1)
+#endif
+
+#define SIM_ALGO_WORDS  (0x600 / 4)
+
+// Contents are filled in by sim_main.c. Only the size and the RAM image matter here
+uint32_t sim_algo_image[SIM_ALGO_WORDS];
+
+const TARGET_FLASH flash = {
+    0x20000021, // Init
+    0x20000049, // UnInit
+    0x2000004D, // EraseChip
+    0x2000006F, // EraseSector
+    0x2000009B, // ProgramPage
+
+    // breakpoint = RAM start + 1
+    // RSB : base address is address of Execution Region PrgData in map file
+    //       to access global/static data
+    // RSP : Initial stack pointer
+    {
+        0x20000001, // breakpoint instruction address
+        0x20000500, // static base
+        0x20001000  // initial stack pointer
+    },
+
+    0x20003000, // program_buffer, any valid RAM location with +4096 bytes of headroom
+    0x20000000, // algo_start, start of RAM
+    sizeof(sim_algo_image), // algo_size, size of array above
+    sim_algo_image,  // image, flash algo instruction array
+    512,        // ram_to_flash_bytes_to_be_written
+#if (SIM_PROGRAM_PAGES == 1)
+    0x200000D5, // ProgramPages
+    4096        // max_program_size
+#else
+    0,
+    0
+#endif
+};
+
+const target_cfg_t target_device = {
+    .board_id   = "0000",
+    .secret     = "xxxxxxxx",
+    .sector_size    = kB(4),
+    .sector_cnt     = (kB(512) / kB(4)),
+    .flash_start    = 0,
+    .flash_end      = kB(512),
+    .ram_start      = 0x20000000,
+    .ram_end        = 0x20010000,
+    .disc_size      = kB(512)
+};
@@ -0,0 +1,152 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// DAP configuration for the host simulator. The pins are routed to the target model
+//  in swd_model.c instead of GPIO registers
+
+#ifndef __DAP_CONFIG_H__
+#define __DAP_CONFIG_H__
+
+#include "stdint.h"
+#include "swd_model.h"
+
+#define CPU_CLOCK               48000000        ///< Specifies the CPU Clock in Hz
+#define IO_PORT_WRITE_CYCLES    2               ///< I/O Cycles: 2=default, 1=Cortex-M0+ fast I/0
+#define DAP_SWD                 1               ///< SWD Mode:  1 = available, 0 = not available
+#define DAP_JTAG                0               ///< JTAG Mode: 1 = available, 0 = not available.
+#define DAP_JTAG_DEV_CNT        0               ///< Maximum number of JTAG devices on scan chain
+#define DAP_DEFAULT_PORT        1               ///< Default JTAG/SWJ Port Mode: 1 = SWD, 2 = JTAG.
+#define DAP_DEFAULT_SWJ_CLOCK   5000000         ///< Default SWD/JTAG clock frequency in Hz.
+#define DAP_PACKET_SIZE         64              ///< USB: 64 = Full-Speed, 1024 = High-Speed.
+#define DAP_PACKET_COUNT        5               ///< Buffers: 64 = Full-Speed, 4 = High-Speed.
+#define TARGET_DEVICE_FIXED     0               ///< Target Device: 1 = known, 0 = unknown;
+
+// SysTick is only used for timeouts in DAP.c and never expires here
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t LOAD;
+    volatile uint32_t VAL;
+    volatile uint32_t CALIB;
+} SysTick_Type;
+extern SysTick_Type sim_systick;
+#define SysTick                         (&sim_systick)
+#define SysTick_CTRL_ENABLE_Pos         0
+#define SysTick_CTRL_CLKSOURCE_Pos      2
+#define SysTick_CTRL_COUNTFLAG_Msk      (1UL << 16)
+
+// Programming profile time stamps come straight from the model clock
+uint32_t sim_time_us(void);
+#define PROFILE_TIME_US()               sim_time_us()
+
+static __inline void PORT_JTAG_SETUP (void) {}
+
+static __inline void PORT_SWD_SETUP (void) {
+    swd_model_swclk(1);
+    swd_model_swdio_out(1);
+    swd_model_swdio_oe(1);
+    swd_model_nreset(1);
+}
+
+static __inline void PORT_OFF (void) {
+    swd_model_swdio_oe(0);
+    swd_model_nreset(1);
+}
+
+static __forceinline uint32_t PIN_SWCLK_TCK_IN  (void) {
+    return (0);   // Not available
+}
+
+static __forceinline void     PIN_SWCLK_TCK_SET (void) {
+    swd_model_swclk(1);
+}
+
+static __forceinline void     PIN_SWCLK_TCK_CLR (void) {
+    swd_model_swclk(0);
+}
+
+static __forceinline uint32_t PIN_SWDIO_TMS_IN  (void) {
+    return swd_model_swdio_in();
+}
+
+static __forceinline void     PIN_SWDIO_TMS_SET (void) {
+    swd_model_swdio_out(1);
+}
+
+static __forceinline void     PIN_SWDIO_TMS_CLR (void) {
+    swd_model_swdio_out(0);
+}
+
+static __forceinline uint32_t PIN_SWDIO_IN      (void) {
+    return swd_model_swdio_in();
+}
+
+static __forceinline void     PIN_SWDIO_OUT     (uint32_t bit) {
+    swd_model_swdio_out(bit);
+}
+
+static __forceinline void     PIN_SWDIO_OUT_ENABLE  (void) {
+    swd_model_swdio_oe(1);
+}
+
+static __forceinline void     PIN_SWDIO_OUT_DISABLE (void) {
+    swd_model_swdio_oe(0);
+}
+
+static __forceinline uint32_t PIN_TDI_IN  (void) {
+    return (0);   // Not available
+}
+
+static __forceinline void     PIN_TDI_OUT (uint32_t bit) {
+    ;             // Not available
+}
+
+static __forceinline uint32_t PIN_TDO_IN  (void) {
+    return (0);   // Not available
+}
+
+static __forceinline uint32_t PIN_nTRST_IN   (void) {
+    return (0);   // Not available
+}
+
+static __forceinline void     PIN_nTRST_OUT  (uint32_t bit) {
+    ;             // Not available
+}
+
+static __forceinline uint32_t PIN_nRESET_IN  (void) {
+    return swd_model_nreset_in();
+}
+
+static __forceinline void     PIN_nRESET_OUT (uint32_t bit) {
+    swd_model_nreset(bit);
+}
+
+static __inline void LED_CONNECTED_OUT (uint32_t bit) {
+    ;             // Not available
+}
+
+static __inline void LED_RUNNING_OUT (uint32_t bit) {
+    ;             // Not available
+}
+
+static __inline void DAP_SETUP (void) {
+    PORT_OFF();
+}
+
+static __inline uint32_t RESET_TARGET (void) {
+    return (0);              // change to '1' when a device reset sequence is implemented
+}
+
+#endif /* __DAP_CONFIG_H__ */
@@ -0,0 +1,48 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The parts of the RTX API used by the sources built into the simulator
+
+#ifndef RTL_H
+#define RTL_H
+
+#include "stdint.h"
+
+typedef uint8_t  U8;
+typedef uint16_t U16;
+typedef uint32_t U32;
+typedef uint32_t BOOL;
+typedef void *OS_TID;
+typedef void *OS_ID;
+typedef U32 OS_RESULT;
+typedef U32 OS_MUT[3];
+
+#define __TRUE  1
+#define __FALSE 0
+
+#define OS_R_TMO    0x01
+#define OS_R_OK     0x00
+
+// One tick is 10ms. Waiting only advances the simulated time
+void os_dly_wait(U16 delay_time);
+U32 os_time_get(void);
+
+// There is a single thread, a mutex is always free
+void os_mut_init(OS_ID mutex);
+OS_RESULT os_mut_wait(OS_ID mutex, U16 timeout);
+OS_RESULT os_mut_release(OS_ID mutex);
+
+#endif
@@ -0,0 +1,31 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// The mass storage globals of the USB stack used by usbd_user_msc.c. The replay
+//  harness in msc_replay.c plays the part of usbd_msc.c
+
+#ifndef __RL_USB_H__
+#define __RL_USB_H__
+
+#include "RTL.h"
+
+extern BOOL USBD_MSC_MediaReady;
+extern U32  USBD_MSC_MemorySize;
+extern U32  USBD_MSC_BlockSize;
+extern U32  USBD_MSC_BlockGroup;
+extern U32  USBD_MSC_BlockCount;
+extern U8  *USBD_MSC_BlockBuf;
+
+#endif
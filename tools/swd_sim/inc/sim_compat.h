@@ -0,0 +1,29 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Keil compiler keywords used by the firmware sources, mapped for gcc/clang.
+//  Included ahead of every source with -include
+
+#ifndef SIM_COMPAT_H
+#define SIM_COMPAT_H
+
+#define __forceinline   inline __attribute__((always_inline))
+#define __inline        inline
+#define __weak          __attribute__((weak))
+#define __task
+#define __nop()         do { } while (0)
+
+#endif
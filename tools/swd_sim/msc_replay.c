@@ -0,0 +1,399 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays recorded mass storage traffic into usbd_user_msc.c. The capture is the text
+//  log tools/usblog.py reads: one USB packet per line as hex bytes. Command blocks
+//  (CBW) start with 55 53 42 43, status blocks (CSW) with 55 53 42 53 and every other
+//  line is data. WRITE10 data is collected from the lines that follow the CBW and
+//  handed over one block at a time like usbd_msc.c does. READ10 is served by
+//  usbd_msc_read_sect and the data recorded for it is skipped. Lines that aren't hex
+//  (comments, blank lines) are ignored.
+//
+// The flash programming runs over SWD against the target model. USB time is added
+//  from a fixed per command overhead and a bulk data rate so the time to the eject is
+//  comparable between captures and firmware builds
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "ctype.h"
+#include "unistd.h"
+#include "RTL.h"
+#include "rl_usb.h"
+#include "usb_buf.h"
+#include "main.h"
+#include "version.h"
+#include "virtual_fs.h"
+#include "target_flash.h"
+#include "target_config.h"
+#include "swd_model.h"
+#include "sim_port.h"
+#include "program_profile.h"
+
+#define CBW_SIGNATURE       (0x43425355)
+#define CSW_SIGNATURE       (0x53425355)
+#define CBW_SIZE            (31)
+#define SCSI_READ10         (0x28)
+#define SCSI_WRITE10        (0x2A)
+#define MAX_LINE            (4096)
+#define MAX_TRANSFER        (kB(512))
+#define MAX_BLOCKS          (65536)
+
+// USB stack state usbd_user_msc.c sets up
+BOOL USBD_MSC_MediaReady;
+U32  USBD_MSC_MemorySize;
+U32  USBD_MSC_BlockSize;
+U32  USBD_MSC_BlockGroup;
+U32  USBD_MSC_BlockCount;
+U8  *USBD_MSC_BlockBuf;
+uint32_t usb_buffer[512/4];
+
+void usbd_msc_init(void);
+void usbd_msc_read_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks);
+void usbd_msc_write_sect(uint32_t block, uint8_t *buf, uint32_t num_of_blocks);
+
+typedef struct {
+    uint32_t commands;
+    uint32_t blocks_written;
+    uint32_t blocks_read;
+    uint32_t out_of_order;      // image blocks usbd_msc_write_sect dropped, ahead of the first one
+                                //  or waiting for the next in order
+    uint32_t after_eject;       // commands left in the capture when the drive ejected
+    uint32_t ejected;
+    uint32_t forced;            // ejected because programming failed
+    uint64_t usb_ns;
+    uint64_t eject_ns;
+} replay_stats_t;
+
+static replay_stats_t replay;
+static uint8_t ignored[MAX_BLOCKS / 8]; // blocks written while no transfer was started
+static uint32_t usb_kbps = 1000;        // bulk data rate of a full speed device
+static uint32_t usb_command_ns = 250000; // CBW, CSW and the frames lost between them
+
+// main.c hooks called from usbd_user_msc.c
+
+void main_blink_msd_led(uint8_t permanent)
+{
+}
+
+static void eject(uint32_t forced)
+{
+    swd_model_stats_t stats;
+    swd_model_get_stats(&stats);
+    replay.ejected = 1;
+    replay.forced = forced;
+    replay.eject_ns = stats.time_ns;
+}
+
+void main_msc_disconnect_event(void)
+{
+    eject(0);
+}
+
+void main_force_msc_disconnect_event(void)
+{
+    eject(1);
+}
+
+void update_html_file(uint8_t *buf, uint32_t bufsize)
+{
+    memcpy(buf, mbed_redirect_file, bufsize);
+}
+
+static void usb_delay(uint64_t ns)
+{
+    replay.usb_ns += ns;
+    swd_model_delay(ns);
+}
+
+static void usb_time(uint32_t bytes)
+{
+    usb_delay(usb_command_ns + ((uint64_t)bytes * 1000000) / usb_kbps);
+}
+
+// Hex bytes of a line. Returns the count or -1 when the line isn't a packet
+static int parse_line(const char *line, uint8_t *out, int max)
+{
+    int n = 0;
+    char *end = 0;
+    unsigned long val = 0;
+
+    while (isspace((unsigned char)*line)) {
+        line++;
+    }
+    if (!isxdigit((unsigned char)*line)) {
+        return -1;
+    }
+    while (*line && (n < max)) {
+        val = strtoul(line, &end, 16);
+        if ((end == line) || (val > 0xff)) {
+            break;
+        }
+        out[n++] = (uint8_t)val;
+        line = end;
+        while (isspace((unsigned char)*line)) {
+            line++;
+        }
+    }
+    return n;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Blocks ignored before the transfer started that lie past its first block were image
+//  data written ahead of it. The metadata and other files come before the image
+static uint32_t count_ignored(uint32_t start_block)
+{
+    uint32_t block, count = 0;
+
+    for (block = start_block + 1; block < MAX_BLOCKS; block++) {
+        count += (ignored[block / 8] >> (block % 8)) & 1;
+    }
+    memset(ignored, 0, sizeof(ignored));
+    return count;
+}
+
+static void write_block(uint32_t block, uint8_t *buf)
+{
+    file_transfer_state_t before = file_transfer_state;
+
+    replay.blocks_written++;
+    memcpy(USBD_MSC_BlockBuf, buf, USBD_MSC_BlockSize);
+    usbd_msc_write_sect(block, USBD_MSC_BlockBuf, 1);
+    if (!before.transfer_started) {
+        if (file_transfer_state.transfer_started) {
+            replay.out_of_order += count_ignored(file_transfer_state.start_block);
+        } else if (block < MAX_BLOCKS) {
+            ignored[block / 8] |= 1 << (block % 8);
+        }
+    }
+    // same test usbd_msc_write_sect makes before it drops a block
+    else if (!before.transfer_failed && (block >= before.start_block) && 
+             (block != (before.last_block_written + 1))) {
+        replay.out_of_order++;
+    }
+}
+
+static void read_blocks(uint32_t block, uint32_t count)
+{
+    while (count--) {
+        replay.blocks_read++;
+        usbd_msc_read_sect(block++, USBD_MSC_BlockBuf, 1);
+    }
+}
+
+static int replay_capture(FILE *f)
+{
+    static char line[MAX_LINE];
+    static uint8_t packet[MAX_LINE / 2];
+    static uint8_t data[MAX_TRANSFER];
+    uint32_t want = 0, have = 0, lba = 0, i = 0;
+    int n = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        n = parse_line(line, packet, sizeof(packet));
+        if (n <= 0) {
+            continue;
+        }
+        // data phase of a WRITE10
+        if (have < want) {
+            n = ((uint32_t)n > (want - have)) ? (want - have) : n;
+            memcpy(&data[have], packet, n);
+            have += n;
+            if (have == want) {
+                // blocks are handed over as they arrive so the bulk time is spread over them
+                usb_time(0);
+                for (i = 0; (i < want / USBD_MSC_BlockSize) && !replay.ejected; i++) {
+                    usb_delay(((uint64_t)USBD_MSC_BlockSize * 1000000) / usb_kbps);
+                    write_block(lba + i, &data[i * USBD_MSC_BlockSize]);
+                }
+                want = have = 0;
+            }
+            continue;
+        }
+        if ((n < CBW_SIZE) || (CBW_SIGNATURE != get_le32(packet))) {
+            continue;
+        }
+        if (replay.ejected) {
+            replay.after_eject++;
+            continue;
+        }
+        replay.commands++;
+        lba = get_be32(&packet[17]);
+        if (SCSI_WRITE10 == packet[15]) {
+            want = ((packet[22] << 8) | packet[23]) * USBD_MSC_BlockSize;
+            have = 0;
+            if (want > sizeof(data)) {
+                printf("WRITE10 of %u bytes is larger than the replay buffer\n", want);
+                return 1;
+            }
+        }
+        else if (SCSI_READ10 == packet[15]) {
+            i = (packet[22] << 8) | packet[23];
+            usb_time(i * USBD_MSC_BlockSize);
+            read_blocks(lba, i);
+        }
+        else {
+            usb_time(get_le32(&packet[8]));
+        }
+    }
+    if (want) {
+        printf("capture ends inside a WRITE10 data phase\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Print blocks of the disc as hex so a script can build captures for this disc layout
+static void dump_blocks(uint32_t block, uint32_t count)
+{
+    uint32_t i = 0;
+    while (count--) {
+        usbd_msc_read_sect(block, USBD_MSC_BlockBuf, 1);
+        printf("%u:", block++);
+        for (i = 0; i < USBD_MSC_BlockSize; i++) {
+            printf(" %02x", USBD_MSC_BlockBuf[i]);
+        }
+        printf("\n");
+    }
+}
+
+static int verify_image(const char *path)
+{
+    uint8_t *image = 0;
+    long size = 0;
+    int fail = 0;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    image = malloc(size);
+    if ((size != (long)fread(image, 1, size, f)) || (size > (long)(target_device.flash_end - target_device.flash_start))) {
+        printf("cannot read %s\n", path);
+        fail = 1;
+    }
+    else {
+        fail = memcmp(swd_model_flash() + target_device.flash_start, image, size) ? 1 : 0;
+    }
+    fclose(f);
+    free(image);
+    return fail;
+}
+
+// PROGRAM.TXT as the firmware measured it against the model clock
+static void print_profile(void)
+{
+    static const char *const names[PROFILE_PHASES] = {"reset", "algo", "erase", "data", "program", "verify", "usb"};
+    uint32_t i = 0;
+    
+    if (!program_profile.done) {
+        return;
+    }
+    printf("profile_total_ms: %.3f\n", program_profile.total_us / 1000.0);
+    for (i = 0; i < PROFILE_PHASES; i++) {
+        printf("profile_%s_ms: %.3f\n", names[i], program_profile.phase_us[i] / 1000.0);
+    }
+    printf("profile_pages: %u\n", program_profile.pages);
+    printf("profile_page_us: %u %u\n", program_profile.page_min_us, program_profile.page_max_us);
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-c swclk_hz] [-u usb_kbps] [-p command_us] [-i image.bin] capture.txt\n"
+           "       %s -d first_block:count\n", name, name);
+}
+
+int main(int argc, char *argv[])
+{
+    swd_model_cfg_t cfg;
+    swd_model_stats_t stats;
+    const char *image = 0;
+    uint32_t first = 0, count = 0, dump = 0;
+    int opt = 0, fail = 0;
+    FILE *f = 0;
+
+    memset(&cfg, 0, sizeof(cfg));
+    while (-1 != (opt = getopt(argc, argv, "c:u:p:i:d:h"))) {
+        switch (opt) {
+            case 'c': cfg.swclk_hz = strtoul(optarg, 0, 0); break;
+            case 'u': usb_kbps = strtoul(optarg, 0, 0); break;
+            case 'p': usb_command_ns = strtoul(optarg, 0, 0) * 1000; break;
+            case 'i': image = optarg; break;
+            case 'd': dump = (2 == sscanf(optarg, "%u:%u", &first, &count)); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if ((0 == usb_kbps) || (!dump && (optind >= argc))) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    sim_port_init();
+    swd_model_init(&cfg);
+    reset_file_transfer_state();
+    usbd_msc_init();
+    if (dump) {
+        dump_blocks(first, count);
+        return 0;
+    }
+
+    f = fopen(argv[optind], "r");
+    if (!f) {
+        printf("cannot open %s\n", argv[optind]);
+        return 2;
+    }
+    fail = replay_capture(f);
+    fclose(f);
+    if (fail) {
+        return 1;
+    }
+
+    swd_model_get_stats(&stats);
+    printf("result: %s\n", !replay.ejected ? "no eject" : (replay.forced ? "fail" : "ok"));
+    if (replay.forced) {
+        printf("fail.txt: %s", (const char *)fs[9].sect);
+    }
+    printf("time_ms: %.3f\n", (replay.ejected ? replay.eject_ns : stats.time_ns) / 1000000.0);
+    printf("usb_ms: %.3f\n", replay.usb_ns / 1000000.0);
+    printf("commands: %u\n", replay.commands);
+    printf("blocks_written: %u\n", replay.blocks_written);
+    printf("blocks_read: %u\n", replay.blocks_read);
+    printf("out_of_order: %u\n", replay.out_of_order);
+    printf("after_eject: %u\n", replay.after_eject);
+    printf("bytes_programmed: %llu\n", (unsigned long long)stats.bytes_programmed);
+    printf("pages_rewritten: %llu\n", (unsigned long long)stats.pages_rewritten);
+    printf("sectors_erased: %llu\n", (unsigned long long)stats.sectors_erased);
+    printf("swd_transactions: %llu\n", (unsigned long long)stats.transactions);
+    print_profile();
+    if (image) {
+        fail = verify_image(image);
+        printf("verify: %s\n", fail ? "mismatch" : "ok");
+    }
+    return (fail || !replay.ejected || replay.forced) ? 1 : 0;
+}
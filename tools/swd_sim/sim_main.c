@@ -0,0 +1,275 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput benchmarks for the SWD host stack. SW_DP.c, DAP.c, swd_host.c and
+//  target_flash.c are built unchanged for the host and drive the target model in
+//  swd_model.c through the pin functions of the simulated DAP_config.h. Times are
+//  simulated target time worked out from the SWCLK cycles and flash busy times, so
+//  the numbers only depend on the protocol traffic and not on the build machine
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+#include "RTL.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "debug_cm.h"
+#include "swd_host.h"
+#include "target_reset.h"
+#include "target_flash.h"
+#include "target_config.h"
+#include "swd_model.h"
+#include "sim_port.h"
+#include "program_profile.h"
+
+#define SIM_MSC_BLOCK   (512)       // size of the writes the MSC drive passes to target_flash
+#define SIM_RAM_TEST    (0x20004000)
+#define SIM_RAM_SIZE    (kB(4))
+
+static swd_model_stats_t last;
+
+// usbd_user_msc.c owns this in the firmware. Never active here so target_flash.c doesn't time anything
+program_profile_t program_profile;
+
+static void report_start(void)
+{
+    swd_model_get_stats(&last);
+}
+
+// Print the counters since report_start. bytes is the payload moved, 0 for none
+static void report(const char *name, uint32_t bytes)
+{
+    swd_model_stats_t now;
+    uint64_t ns = 0;
+
+    swd_model_get_stats(&now);
+    ns = now.time_ns - last.time_ns;
+    printf("%-26s %10llu clk %7llu xfer %6llu wait %4llu fault %5llu call %10.3f ms",
+           name,
+           (unsigned long long)(now.swclk_cycles - last.swclk_cycles),
+           (unsigned long long)(now.transactions - last.transactions),
+           (unsigned long long)(now.ack_wait - last.ack_wait),
+           (unsigned long long)(now.ack_fault - last.ack_fault),
+           (unsigned long long)(now.syscalls - last.syscalls),
+           ns / 1000000.0);
+    if (bytes && ns) {
+        printf(" %9.1f KB/s", (bytes / 1024.0) / (ns / 1000000000.0));
+    }
+    printf("\n");
+    last = now;
+}
+
+static int bench_memory(void)
+{
+    static uint8_t out[SIM_RAM_SIZE], in[SIM_RAM_SIZE];
+
+    sim_fill_random(out, sizeof(out));
+    report_start();
+    if (0 == swd_write_memory(SIM_RAM_TEST, out, sizeof(out))) {
+        printf("RAM write failed\n");
+        return 1;
+    }
+    report("RAM write 4KB", sizeof(out));
+    if (0 == swd_read_memory(SIM_RAM_TEST, in, sizeof(in))) {
+        printf("RAM read failed\n");
+        return 1;
+    }
+    report("RAM read 4KB", sizeof(in));
+    if (0 != memcmp(out, in, sizeof(out))) {
+        printf("RAM read back mismatch\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int bench_flash(const char *name, const uint8_t *image, uint32_t size)
+{
+    target_flash_status_t status = TARGET_OK;
+    uint32_t addr = 0;
+
+    report_start();
+    status = target_flash_init(BIN);
+    if (TARGET_OK != status) {
+        printf("target_flash_init failed (%d)\n", status);
+        return 1;
+    }
+    report("  init + erase chip", 0);
+    for (addr = 0; addr < size; addr += SIM_MSC_BLOCK) {
+        status = target_flash_program_page(addr, (uint8_t *)image + addr, SIM_MSC_BLOCK);
+        if (TARGET_OK != status) {
+            printf("target_flash_program_page failed at 0x%x (%d)\n", addr, status);
+            return 1;
+        }
+    }
+    status = target_flash_uninit();
+    if (TARGET_OK != status) {
+        printf("target_flash_uninit failed (%d)\n", status);
+        return 1;
+    }
+    report("  program", size);
+    if (0 != memcmp(swd_model_flash() + target_device.flash_start, image, size)) {
+        printf("flash contents do not match the image\n");
+        return 1;
+    }
+    printf("%s: %u bytes verified\n", name, size);
+    return 0;
+}
+
+// Push a command through DAP_ProcessCommand the way usbd_user_hid.c does
+static uint32_t dap_command(uint8_t *request, uint8_t *response)
+{
+    memset(response, 0, DAP_PACKET_SIZE);
+    return DAP_ProcessCommand(request, response);
+}
+
+static int bench_dap(uint32_t iterations)
+{
+    uint8_t req[DAP_PACKET_SIZE], rsp[DAP_PACKET_SIZE];
+    uint32_t i = 0, n = 0, words = (DAP_PACKET_SIZE - 4) / 4;
+    uint32_t csw = CSW_SIZE32 | CSW_SADDRINC | CSW_DBGSTAT | CSW_HPROT | CSW_MSTRDBG | CSW_RESERVED;
+    uint32_t tar = SIM_RAM_TEST;
+
+    req[0] = ID_DAP_Connect;
+    req[1] = DAP_PORT_SWD;
+    dap_command(req, rsp);
+    if (DAP_PORT_SWD != rsp[1]) {
+        printf("DAP_Connect failed\n");
+        return 1;
+    }
+
+    // DP IDCODE reads, the shortest transfer there is
+    n = 0;
+    req[n++] = ID_DAP_Transfer;
+    req[n++] = 0;
+    req[n++] = 8;
+    for (i = 0; i < 8; i++) {
+        req[n++] = DAP_TRANSFER_RnW | DP_IDCODE;
+    }
+    report_start();
+    for (i = 0; i < iterations; i++) {
+        dap_command(req, rsp);
+        if ((8 != rsp[1]) || (DAP_TRANSFER_OK != rsp[2])) {
+            printf("DAP_Transfer failed (%d, %d)\n", rsp[1], rsp[2]);
+            return 1;
+        }
+    }
+    report("DAP_Transfer 8 x IDCODE", 0);
+
+    // select bank 0 of AP 0 and set up a word transfer from RAM
+    n = 0;
+    req[n++] = ID_DAP_Transfer;
+    req[n++] = 0;
+    req[n++] = 3;
+    req[n++] = DP_SELECT;
+    memset(&req[n], 0, 4);
+    n += 4;
+    req[n++] = DAP_TRANSFER_APnDP | AP_CSW;
+    memcpy(&req[n], &csw, 4);
+    n += 4;
+    req[n++] = DAP_TRANSFER_APnDP | AP_TAR;
+    memcpy(&req[n], &tar, 4);
+    n += 4;
+
+    report_start();
+    for (i = 0; i < iterations; i++) {
+        dap_command(req, rsp);
+        if ((3 != rsp[1]) || (DAP_TRANSFER_OK != rsp[2])) {
+            printf("DAP_Transfer setup failed (%d, %d)\n", rsp[1], rsp[2]);
+            return 1;
+        }
+    }
+    report("DAP_Transfer CSW + TAR", 0);
+
+    req[0] = ID_DAP_TransferBlock;
+    req[1] = 0;
+    req[2] = (uint8_t)words;
+    req[3] = 0;
+    req[4] = DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | AP_DRW;
+    report_start();
+    for (i = 0; i < iterations; i++) {
+        dap_command(req, rsp);
+        if ((words != rsp[1]) || (DAP_TRANSFER_OK != rsp[3])) {
+            printf("DAP_TransferBlock failed (%d, %d)\n", rsp[1], rsp[3]);
+            return 1;
+        }
+    }
+    report("DAP_TransferBlock read", iterations * words * 4);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-c swclk_hz] [-w wait_every] [-b ap_busy_cycles] [-s image_size] [-t tar_wrap] [-n iterations]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    swd_model_cfg_t cfg;
+    uint32_t size = kB(64), iterations = 100;
+    uint8_t *image = 0;
+    int opt = 0, fail = 0;
+
+    memset(&cfg, 0, sizeof(cfg));
+    while (-1 != (opt = getopt(argc, argv, "c:w:b:s:t:n:h"))) {
+        switch (opt) {
+            case 'c': cfg.swclk_hz = strtoul(optarg, 0, 0); break;
+            case 'w': cfg.wait_every = strtoul(optarg, 0, 0); break;
+            case 'b': cfg.ap_busy_cycles = strtoul(optarg, 0, 0); break;
+            case 's': size = strtoul(optarg, 0, 0); break;
+            case 't': cfg.tar_wrap = strtoul(optarg, 0, 0); break;
+            case 'n': iterations = strtoul(optarg, 0, 0); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if ((0 == size) || (size % SIM_MSC_BLOCK) || (size > (target_device.flash_end - target_device.flash_start))) {
+        printf("image size must be a non zero multiple of %d that fits the flash\n", SIM_MSC_BLOCK);
+        return 2;
+    }
+
+    sim_port_init();
+    image = malloc(size);
+    sim_fill_random(image, size);
+    // a valid vector table: stack at the top of RAM, reset handler in flash
+    ((uint32_t *)image)[0] = target_device.ram_end;
+    ((uint32_t *)image)[1] = target_device.flash_start + 0x101;
+
+    swd_model_init(&cfg);
+    printf("program_pages %s, %u byte image\n", flash.program_pages ? "enabled" : "disabled", size);
+
+    report_start();
+    if (0 == swd_init_debug()) {
+        printf("swd_init_debug failed\n");
+        return 1;
+    }
+    report("connect", 0);
+
+    fail |= bench_memory();
+    if (0 == fail) {
+        printf("flash, cold (algorithm download):\n");
+        fail |= bench_flash("cold", image, size);
+    }
+    if (0 == fail) {
+        // the image programmed again, like dragging the same file twice
+        printf("flash, warm (algorithm resident):\n");
+        fail |= bench_flash("warm", image, size);
+    }
+    if (0 == fail) {
+        fail |= bench_dap(iterations);
+    }
+    free(image);
+    return fail;
+}
@@ -0,0 +1,131 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// RTOS and target hooks the firmware sources expect, shared by every simulator program
+
+#include "RTL.h"
+#include "DAP_config.h"
+#include "swd_host.h"
+#include "target_reset.h"
+#include "semihost.h"
+#include "gdb_server.h"
+#include "swd_model.h"
+#include "sim_port.h"
+
+extern uint32_t sim_algo_image[0x600 / 4];
+
+SysTick_Type sim_systick;
+
+static uint32_t rand_state = 1;
+
+void os_dly_wait(U16 delay_time)
+{
+    swd_model_delay((uint64_t)delay_time * 10 * 1000 * 1000);
+}
+
+U32 os_time_get(void)
+{
+    swd_model_stats_t stats;
+    swd_model_get_stats(&stats);
+    return (U32)(stats.time_ns / (10 * 1000 * 1000));
+}
+
+void os_mut_init(OS_ID mutex)
+{
+}
+
+OS_RESULT os_mut_wait(OS_ID mutex, U16 timeout)
+{
+    return OS_R_OK;
+}
+
+OS_RESULT os_mut_release(OS_ID mutex)
+{
+    return OS_R_OK;
+}
+
+uint32_t sim_time_us(void)
+{
+    swd_model_stats_t stats;
+    swd_model_get_stats(&stats);
+    return (uint32_t)(stats.time_ns / 1000);
+}
+
+void semihost_enable(void)
+{
+}
+
+void semihost_disable(void)
+{
+}
+
+uint8_t semihost_pause(void)
+{
+    return 0;
+}
+
+void semihost_resume(void)
+{
+}
+
+void gdb_server_disable(void)
+{
+}
+
+uint8_t gdb_server_active(void)
+{
+    return 0;
+}
+
+void target_before_init_debug(void)
+{
+}
+
+uint8_t target_unlock_sequence(void)
+{
+    return 1;
+}
+
+uint8_t target_set_state(TARGET_RESET_STATE state)
+{
+    return swd_set_target_state(state);
+}
+
+uint8_t security_bits_set(uint32_t addr, uint8_t *data, uint32_t size)
+{
+    return 0;
+}
+
+uint32_t sim_rand(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return rand_state >> 8;
+}
+
+void sim_fill_random(uint8_t *buf, uint32_t size)
+{
+    uint32_t i;
+    for (i = 0; i < size; i++) {
+        buf[i] = (uint8_t)sim_rand();
+    }
+}
+
+void sim_port_init(void)
+{
+    uint32_t i;
+    for (i = 0; i < sizeof(sim_algo_image) / 4; i++) {
+        sim_algo_image[i] = sim_rand();
+    }
+}
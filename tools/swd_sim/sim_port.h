@@ -0,0 +1,28 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SIM_PORT_H
+#define SIM_PORT_H
+
+#include "stdint.h"
+
+// Fill the simulated flash algorithm. Call before swd_model_init
+void sim_port_init(void);
+
+// A repeatable sequence for test data
+uint32_t sim_rand(void);
+void sim_fill_random(uint8_t *buf, uint32_t size);
+
+#endif
@@ -0,0 +1,814 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cycle counting model of a SW-DP, a MEM-AP, the Cortex-M debug registers, RAM and a
+//  flash controller. The firmware drives it through the pin functions exactly as it
+//  drives the GPIOs. Every rising SWCLK edge is one bit of the wire protocol.
+//
+// The core can't execute code. When it is resumed at one of the entries of the flash
+//  algorithm in flash_blob.c the matching operation is done by the flash controller,
+//  the core stays running for the operation's busy time and then halts on the
+//  breakpoint with the result in R0. The algorithm must be in RAM for this to happen.
+//  The CRC routine of target_flash.c is recognised by its first words the same way.
+
+#include "swd_model.h"
+#include "target_struct.h"
+#include "debug_cm.h"
+#include "crc.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define DEFAULT_SWCLK_HZ        (1000000)
+#define DEFAULT_IDCODE          (0x2BA01477)
+#define DEFAULT_TAR_WRAP        (4096)
+#define DEFAULT_FLASH_SIZE      (0x80000)
+#define DEFAULT_SECTOR_SIZE     (4096)
+#define DEFAULT_PAGE_SIZE       (512)
+#define DEFAULT_RAM_START       (0x20000000)
+#define DEFAULT_RAM_SIZE        (0x10000)
+#define DEFAULT_ERASE_CHIP_NS   (100000000)
+#define DEFAULT_ERASE_SECTOR_NS (14000000)
+#define DEFAULT_PROGRAM_NS      (30000)
+#define DEFAULT_SYSCALL_NS      (5000)
+#define CRC_BYTE_NS             (250)
+
+// first words of the CRC routine in target_flash.c: the breakpoint, then the entry
+#define CRC_ROUTINE_BKPT        (0xE7FEBE00)
+#define CRC_ROUTINE_ENTRY       (0xA30A43D2)
+
+// protocol constants
+#define ACK_OK                  (0x1)
+#define ACK_WAIT                (0x2)
+#define ACK_FAULT               (0x4)
+#define ACK_NONE                (0x7)
+#define LINE_RESET_BITS         (50)
+#define TURNAROUND              (1)
+
+#define DBGKEY_MASK             (0xFFFF0000)
+#define DHCSR_ADDR              (0xE000EDF0)
+#define DCRSR_ADDR              (0xE000EDF4)
+#define DCRDR_ADDR              (0xE000EDF8)
+#define DEMCR_ADDR              (0xE000EDFC)
+#define AIRCR_ADDR              (0xE000ED0C)
+#define AP_IDR_VALUE            (0x04770031)
+#define AP_ROM_VALUE            (0xE00FF003)
+#define REGWNR                  (1 << 16)
+
+typedef enum {
+    WIRE_IDLE = 0,
+    WIRE_REQUEST,
+    WIRE_TURN_TO_TARGET,
+    WIRE_ACK,
+    WIRE_READ_DATA,
+    WIRE_TURN_TO_HOST,
+    WIRE_WRITE_DATA
+} wire_state_t;
+
+typedef enum {
+    ALGO_NONE = 0,
+    ALGO_INIT,
+    ALGO_UNINIT,
+    ALGO_ERASE_CHIP,
+    ALGO_ERASE_SECTOR,
+    ALGO_PROGRAM_PAGE,
+    ALGO_PROGRAM_PAGES,
+    ALGO_CRC
+} algo_op_t;
+
+static swd_model_cfg_t cfg;
+static swd_model_stats_t stats;
+static uint64_t period_ps;
+static uint64_t time_ps;
+static uint8_t *flash_mem = 0;
+static uint8_t *ram_mem = 0;
+static uint8_t *page_written = 0;   // one flag per flash page, cleared by an erase
+
+// wire
+static struct {
+    wire_state_t state;
+    uint32_t swclk;
+    uint32_t host_bit;
+    uint32_t host_oe;
+    uint32_t target_bit;
+    uint32_t ones;          // consecutive ones driven by the host
+    uint32_t bits;          // bits of the current phase
+    uint32_t cnt;
+    uint32_t request;
+    uint32_t ack;
+    uint32_t data;
+    uint32_t turn_next;     // phase after a turnaround
+} wire;
+
+// debug port and memory access port
+static struct {
+    uint32_t need_idcode;   // a line reset locks the DP until IDCODE is read
+    uint32_t ctrl_stat;
+    uint32_t select;
+    uint32_t rdbuff;
+    uint32_t csw;
+    uint32_t tar;
+    uint32_t ap_accesses;
+    uint64_t ap_busy_until;
+} dp;
+
+// core
+static struct {
+    uint32_t nreset;
+    uint32_t dhcsr;         // control bits written by the debugger
+    uint32_t halted;
+    uint32_t running_algo;
+    uint64_t algo_done_ps;
+    uint32_t algo_result;
+    uint32_t dcrdr;
+    uint32_t demcr;
+    uint32_t regs[32];
+} core;
+
+static uint32_t parity32(uint32_t v)
+{
+    v ^= v >> 16;
+    v ^= v >> 8;
+    v ^= v >> 4;
+    v ^= v >> 2;
+    v ^= v >> 1;
+    return v & 1;
+}
+
+static uint8_t *mem_ptr(uint32_t addr)
+{
+    if ((addr >= cfg.ram_start) && ((addr - cfg.ram_start) < cfg.ram_size)) {
+        return ram_mem + (addr - cfg.ram_start);
+    }
+    if ((addr >= cfg.flash_start) && ((addr - cfg.flash_start) < cfg.flash_size)) {
+        return flash_mem + (addr - cfg.flash_start);
+    }
+    return 0;
+}
+
+static void core_reset(void)
+{
+    uint8_t *vectors = mem_ptr(cfg.flash_start);
+    memset(core.regs, 0, sizeof(core.regs));
+    memcpy(&core.regs[13], vectors, 4);
+    memcpy(&core.regs[15], vectors + 4, 4);
+    core.regs[16] = 0x01000000;
+    core.running_algo = 0;
+    // vector catch on reset needs debug enabled
+    core.halted = ((core.demcr & VC_CORERESET) && (core.dhcsr & C_DEBUGEN)) ? 1 : 0;
+}
+
+static algo_op_t algo_entry(uint32_t pc)
+{
+    if (0 == pc) {
+        return ALGO_NONE;
+    }
+    if (pc == flash.init) {
+        return ALGO_INIT;
+    }
+    if (pc == flash.uninit) {
+        return ALGO_UNINIT;
+    }
+    if (pc == flash.erase_chip) {
+        return ALGO_ERASE_CHIP;
+    }
+    if (pc == flash.erase_sector) {
+        return ALGO_ERASE_SECTOR;
+    }
+    if (pc == flash.program_pages) {
+        return ALGO_PROGRAM_PAGES;
+    }
+    if (pc == flash.program_page) {
+        return ALGO_PROGRAM_PAGE;
+    }
+    return ALGO_NONE;
+}
+
+static uint32_t flash_program(uint32_t addr, uint32_t size, uint32_t buf, uint32_t max_size, uint64_t *busy_ns)
+{
+    uint8_t *dst = mem_ptr(addr), *src = mem_ptr(buf);
+    uint32_t i;
+    if ((0 == dst) || (dst < flash_mem) || (0 == src) || (src < ram_mem) || (0 == size) || (size > max_size)) {
+        return 1;
+    }
+    if (((addr - cfg.flash_start) % cfg.page_size) || ((addr - cfg.flash_start + size) > cfg.flash_size)) {
+        return 1;
+    }
+    // NOR flash can only clear bits. Programming without an erase shows up in a verify
+    for (i = 0; i < size; i++) {
+        dst[i] &= src[i];
+    }
+    for (i = (addr - cfg.flash_start) / cfg.page_size; i < (addr - cfg.flash_start + size + cfg.page_size - 1) / cfg.page_size; i++) {
+        stats.pages_rewritten += page_written[i];
+        page_written[i] = 1;
+    }
+    stats.bytes_programmed += size;
+    *busy_ns += (uint64_t)((size + 7) / 8) * cfg.program_ns;
+    return 0;
+}
+
+static uint8_t is_crc_routine(uint32_t pc)
+{
+    uint8_t *code = mem_ptr(pc - 4), *end = mem_ptr(pc + 3);
+    uint32_t words[2];
+    if ((0 == code) || (end != (code + 7))) {
+        return 0;
+    }
+    memcpy(words, code, sizeof(words));
+    return ((CRC_ROUTINE_BKPT == words[0]) && (CRC_ROUTINE_ENTRY == words[1])) ? 1 : 0;
+}
+
+static void core_resume(void)
+{
+    uint64_t busy_ns = cfg.syscall_ns;
+    uint32_t pc = core.regs[15] & ~1, result = 0;
+    uint32_t r0 = core.regs[0], r1 = core.regs[1], r2 = core.regs[2];
+    uint8_t *algo = mem_ptr(flash.algo_start);
+    uint8_t *src = 0;
+    algo_op_t op = algo_entry(core.regs[15]);
+
+    core.halted = 0;
+    if ((ALGO_NONE == op) && (ALGO_NONE != algo_entry(pc | 1))) {
+        op = algo_entry(pc | 1);
+    }
+    if ((ALGO_NONE == op) && is_crc_routine(pc)) {
+        op = ALGO_CRC;
+    }
+    if (ALGO_NONE == op) {
+        // application code. Runs until halted
+        return;
+    }
+    // a missing or damaged algorithm never reaches the breakpoint
+    if ((ALGO_CRC != op) && ((0 == algo) || (0 != memcmp(algo, flash.image, flash.algo_size)))) {
+        return;
+    }
+    // nor does a CRC of memory that isn't there, the core faults
+    if (ALGO_CRC == op) {
+        src = mem_ptr(r0);
+        if ((0 == src) || (0 == r1) || (mem_ptr(r0 + r1 - 1) != (src + r1 - 1))) {
+            return;
+        }
+    }
+    stats.syscalls++;
+    switch (op) {
+        case ALGO_INIT:
+        case ALGO_UNINIT:
+            break;
+        case ALGO_ERASE_CHIP:
+            memset(flash_mem, 0xff, cfg.flash_size);
+            memset(page_written, 0, cfg.flash_size / cfg.page_size);
+            stats.sectors_erased += cfg.flash_size / cfg.sector_size;
+            busy_ns += cfg.erase_chip_ns;
+            break;
+        case ALGO_ERASE_SECTOR:
+            if ((r0 < cfg.flash_start) || ((r0 - cfg.flash_start) >= cfg.flash_size)) {
+                result = 1;
+                break;
+            }
+            r0 -= (r0 - cfg.flash_start) % cfg.sector_size;
+            memset(mem_ptr(r0), 0xff, cfg.sector_size);
+            memset(&page_written[(r0 - cfg.flash_start) / cfg.page_size], 0, cfg.sector_size / cfg.page_size);
+            stats.sectors_erased++;
+            busy_ns += cfg.erase_sector_ns;
+            break;
+        case ALGO_PROGRAM_PAGE:
+            result = flash_program(r0, r1, r2, cfg.page_size, &busy_ns);
+            break;
+        case ALGO_PROGRAM_PAGES:
+            result = flash_program(r0, r1, r2, flash.max_program_size ? flash.max_program_size : cfg.page_size, &busy_ns);
+            break;
+        case ALGO_CRC:
+            result = crc32(r2, src, r1);
+            busy_ns += (uint64_t)r1 * CRC_BYTE_NS;
+            break;
+        default:
+            break;
+    }
+    core.running_algo = 1;
+    core.algo_result = result;
+    core.algo_done_ps = time_ps + (busy_ns * 1000);
+}
+
+static void core_update(void)
+{
+    if (core.running_algo && (time_ps >= core.algo_done_ps)) {
+        core.running_algo = 0;
+        core.halted = 1;
+        core.regs[0] = core.algo_result;
+        core.regs[15] = core.regs[14] & ~1;
+    }
+}
+
+// 32 bit access to memory and the system control space. Returns 0 on a bus error
+static uint32_t bus_read(uint32_t addr, uint32_t *val)
+{
+    uint8_t *p;
+    addr &= ~3;
+    core_update();
+    switch (addr) {
+        case DHCSR_ADDR:
+            *val = (core.dhcsr & 0xffff) | S_REGRDY | (core.halted ? S_HALT : 0) | (core.nreset ? 0 : S_RESET_ST);
+            return 1;
+        case DCRDR_ADDR:
+            *val = core.dcrdr;
+            return 1;
+        case DCRSR_ADDR:
+            *val = 0;
+            return 1;
+        case DEMCR_ADDR:
+            *val = core.demcr;
+            return 1;
+        case AIRCR_ADDR:
+            *val = 0xFA050000;
+            return 1;
+        default:
+            break;
+    }
+    p = mem_ptr(addr);
+    if (0 == p) {
+        return 0;
+    }
+    memcpy(val, p, 4);
+    return 1;
+}
+
+static uint32_t bus_write(uint32_t addr, uint32_t val, uint32_t lanes)
+{
+    uint8_t *p;
+    uint32_t i;
+    addr &= ~3;
+    core_update();
+    switch (addr) {
+        case DHCSR_ADDR:
+            if ((val & DBGKEY_MASK) != DBGKEY) {
+                return 1;
+            }
+            core.dhcsr = val & 0xffff;
+            if (val & C_HALT) {
+                core.halted = 1;
+                core.running_algo = 0;
+            }
+            else if (core.halted && (val & C_DEBUGEN)) {
+                core_resume();
+            }
+            return 1;
+        case DCRSR_ADDR:
+            if ((val & 0x1f) < 32) {
+                if (val & REGWNR) {
+                    core.regs[val & 0x1f] = core.dcrdr;
+                }
+                else {
+                    core.dcrdr = core.regs[val & 0x1f];
+                }
+            }
+            return 1;
+        case DCRDR_ADDR:
+            core.dcrdr = val;
+            return 1;
+        case DEMCR_ADDR:
+            core.demcr = val;
+            return 1;
+        case AIRCR_ADDR:
+            if (((val >> 16) == 0x05FA) && (val & (SYSRESETREQ | VECTRESET))) {
+                core_reset();
+            }
+            return 1;
+        default:
+            break;
+    }
+    p = mem_ptr(addr);
+    // the flash is only written through the flash controller
+    if ((0 == p) || (p < ram_mem) || (p >= (ram_mem + cfg.ram_size))) {
+        return 0;
+    }
+    for (i = 0; i < 4; i++) {
+        if (lanes & (1 << i)) {
+            p[i] = (uint8_t)(val >> (8 * i));
+        }
+    }
+    return 1;
+}
+
+static void tar_increment(void)
+{
+    uint32_t size = 1 << (dp.csw & CSW_SIZE);
+    if (CSW_SADDRINC == (dp.csw & CSW_ADDRINC)) {
+        dp.tar = (dp.tar & ~(cfg.tar_wrap - 1)) | ((dp.tar + size) & (cfg.tar_wrap - 1));
+    }
+}
+
+static uint32_t ap_lanes(void)
+{
+    switch (dp.csw & CSW_SIZE) {
+        case CSW_SIZE8:
+            return 1 << (dp.tar & 3);
+        case CSW_SIZE16:
+            return 3 << (dp.tar & 2);
+        default:
+            return 0xf;
+    }
+}
+
+// Work out the acknowledge for a request before any data moves
+static uint32_t request_ack(uint32_t req)
+{
+    uint32_t apndp = req & 1, rnw = (req >> 1) & 1, a = (req >> 2) & 3;
+    if (dp.need_idcode && !(!apndp && rnw && (0 == a))) {
+        return ACK_NONE;
+    }
+    if (apndp || (rnw && (3 == a))) {
+        if (dp.ctrl_stat & (STICKYERR | STICKYORUN)) {
+            return ACK_FAULT;
+        }
+        if (stats.swclk_cycles < dp.ap_busy_until) {
+            return ACK_WAIT;
+        }
+        if (apndp && cfg.wait_every && (0 == (++dp.ap_accesses % cfg.wait_every))) {
+            return ACK_WAIT;
+        }
+    }
+    return ACK_OK;
+}
+
+static uint32_t ap_read(uint32_t a)
+{
+    uint32_t reg = (dp.select & APBANKSEL) | (a << 2), val = 0;
+    if (dp.select & APSEL) {
+        return 0;
+    }
+    switch (reg) {
+        case AP_CSW:
+            return dp.csw;
+        case AP_TAR:
+            return dp.tar;
+        case AP_DRW:
+            if (0 == bus_read(dp.tar, &val)) {
+                dp.ctrl_stat |= STICKYERR;
+            }
+            tar_increment();
+            return val;
+        case AP_BD0:
+        case AP_BD1:
+        case AP_BD2:
+        case AP_BD3:
+            if (0 == bus_read((dp.tar & ~0xf) | (reg & 0xc), &val)) {
+                dp.ctrl_stat |= STICKYERR;
+            }
+            return val;
+        case AP_ROM:
+            return AP_ROM_VALUE;
+        case AP_IDR:
+            return AP_IDR_VALUE;
+        default:
+            return 0;
+    }
+}
+
+static void ap_write(uint32_t a, uint32_t val)
+{
+    uint32_t reg = (dp.select & APBANKSEL) | (a << 2);
+    if (dp.select & APSEL) {
+        return;
+    }
+    switch (reg) {
+        case AP_CSW:
+            dp.csw = val;
+            break;
+        case AP_TAR:
+            dp.tar = val;
+            break;
+        case AP_DRW:
+            if (0 == bus_write(dp.tar, val, ap_lanes())) {
+                dp.ctrl_stat |= STICKYERR;
+            }
+            tar_increment();
+            dp.ap_busy_until = stats.swclk_cycles + cfg.ap_busy_cycles;
+            break;
+        case AP_BD0:
+        case AP_BD1:
+        case AP_BD2:
+        case AP_BD3:
+            if (0 == bus_write((dp.tar & ~0xf) | (reg & 0xc), val, 0xf)) {
+                dp.ctrl_stat |= STICKYERR;
+            }
+            dp.ap_busy_until = stats.swclk_cycles + cfg.ap_busy_cycles;
+            break;
+        default:
+            break;
+    }
+}
+
+// Data returned for an acknowledged read
+static uint32_t do_read(uint32_t req)
+{
+    uint32_t a = (req >> 2) & 3, val = 0;
+    if (req & 1) {
+        // posted. The data of the previous AP read is returned
+        val = dp.rdbuff;
+        dp.rdbuff = ap_read(a);
+        return val;
+    }
+    switch (a) {
+        case 0:
+            dp.need_idcode = 0;
+            return cfg.idcode;
+        case 1:
+            // power up requests are acknowledged straight away
+            return (dp.ctrl_stat & ~(CDBGPWRUPACK | CSYSPWRUPACK)) | ((dp.ctrl_stat & (CDBGPWRUPREQ | CSYSPWRUPREQ)) << 1);
+        case 2:
+            return dp.rdbuff;
+        default:
+            return dp.rdbuff;
+    }
+}
+
+static void do_write(uint32_t req, uint32_t val)
+{
+    uint32_t a = (req >> 2) & 3;
+    if (req & 1) {
+        ap_write(a, val);
+        return;
+    }
+    switch (a) {
+        case 0:
+            if (val & STKCMPCLR) {
+                dp.ctrl_stat &= ~STICKYCMP;
+            }
+            if (val & STKERRCLR) {
+                dp.ctrl_stat &= ~STICKYERR;
+            }
+            if (val & WDERRCLR) {
+                dp.ctrl_stat &= ~WDATAERR;
+            }
+            if (val & ORUNERRCLR) {
+                dp.ctrl_stat &= ~STICKYORUN;
+            }
+            break;
+        case 1:
+            if (!(dp.select & CTRLSEL)) {
+                dp.ctrl_stat = (dp.ctrl_stat & (STICKYERR | STICKYCMP | STICKYORUN | WDATAERR)) | (val & ~(STICKYERR | STICKYCMP | STICKYORUN | WDATAERR));
+            }
+            break;
+        case 2:
+            dp.select = val;
+            break;
+        default:
+            break;
+    }
+}
+
+static void request_done(void)
+{
+    uint32_t req = wire.request;
+    uint32_t start = req & 1, apndp = (req >> 1) & 1, rnw = (req >> 2) & 1;
+    uint32_t a2 = (req >> 3) & 1, a3 = (req >> 4) & 1, par = (req >> 5) & 1;
+    uint32_t stop = (req >> 6) & 1, park = (req >> 7) & 1;
+
+    if (!start || stop || !park || (par != ((apndp + rnw + a2 + a3) & 1))) {
+        wire.state = WIRE_IDLE;
+        return;
+    }
+    stats.transactions++;
+    wire.request = apndp | (rnw << 1) | (a2 << 2) | (a3 << 3);
+    wire.ack = request_ack(wire.request);
+    if (ACK_NONE == wire.ack) {
+        stats.no_response++;
+        wire.state = WIRE_IDLE;
+        return;
+    }
+    if (ACK_WAIT == wire.ack) {
+        stats.ack_wait++;
+    }
+    else if (ACK_FAULT == wire.ack) {
+        stats.ack_fault++;
+    }
+    wire.cnt = TURNAROUND;
+    wire.turn_next = WIRE_ACK;
+    wire.state = WIRE_TURN_TO_TARGET;
+}
+
+// One bit of the protocol. The target samples the host on the rising edge and
+//  changes its own output right after it, ready for the host to read while SWCLK is low
+static void clock_edge(void)
+{
+    stats.swclk_cycles++;
+    time_ps += period_ps;
+
+    if (wire.host_oe) {
+        wire.ones = wire.host_bit ? (wire.ones + 1) : 0;
+        if (wire.ones >= LINE_RESET_BITS) {
+            wire.state = WIRE_IDLE;
+            wire.target_bit = 1;
+            dp.need_idcode = 1;
+            return;
+        }
+    }
+
+    switch (wire.state) {
+        case WIRE_IDLE:
+            wire.target_bit = 1;
+            if (wire.host_oe && wire.host_bit) {
+                wire.request = 1;
+                wire.bits = 1;
+                wire.state = WIRE_REQUEST;
+            }
+            break;
+
+        case WIRE_REQUEST:
+            wire.request |= (wire.host_oe ? wire.host_bit : 1) << wire.bits;
+            if (++wire.bits == 8) {
+                request_done();
+            }
+            break;
+
+        case WIRE_TURN_TO_TARGET:
+            if (--wire.cnt == 0) {
+                // the data of a read is decided with the acknowledge
+                if ((ACK_OK == wire.ack) && (wire.request & 2)) {
+                    wire.data = do_read(wire.request);
+                }
+                wire.bits = 0;
+                wire.target_bit = wire.ack & 1;
+                wire.state = WIRE_ACK;
+            }
+            break;
+
+        case WIRE_ACK:
+            if (++wire.bits < 3) {
+                wire.target_bit = (wire.ack >> wire.bits) & 1;
+                break;
+            }
+            if ((ACK_OK == wire.ack) && (wire.request & 2)) {
+                wire.bits = 0;
+                wire.target_bit = wire.data & 1;
+                wire.state = WIRE_READ_DATA;
+            }
+            else {
+                wire.target_bit = 1;
+                wire.cnt = TURNAROUND;
+                wire.turn_next = (ACK_OK == wire.ack) ? WIRE_WRITE_DATA : WIRE_IDLE;
+                wire.bits = 0;
+                wire.data = 0;
+                wire.state = WIRE_TURN_TO_HOST;
+            }
+            break;
+
+        case WIRE_READ_DATA:
+            wire.bits++;
+            if (wire.bits < 32) {
+                wire.target_bit = (wire.data >> wire.bits) & 1;
+            }
+            else if (32 == wire.bits) {
+                wire.target_bit = parity32(wire.data);
+            }
+            else {
+                wire.target_bit = 1;
+                wire.cnt = TURNAROUND;
+                wire.turn_next = WIRE_IDLE;
+                wire.state = WIRE_TURN_TO_HOST;
+            }
+            break;
+
+        case WIRE_TURN_TO_HOST:
+            if (--wire.cnt == 0) {
+                wire.state = (wire_state_t)wire.turn_next;
+            }
+            break;
+
+        case WIRE_WRITE_DATA:
+            if (wire.bits < 32) {
+                wire.data |= (wire.host_bit & 1) << wire.bits;
+                wire.bits++;
+            }
+            else {
+                if ((wire.host_bit & 1) != parity32(wire.data)) {
+                    dp.ctrl_stat |= WDATAERR;
+                }
+                else {
+                    do_write(wire.request, wire.data);
+                }
+                wire.state = WIRE_IDLE;
+            }
+            break;
+
+        default:
+            wire.state = WIRE_IDLE;
+            break;
+    }
+}
+
+void swd_model_init(const swd_model_cfg_t *config)
+{
+    static const swd_model_cfg_t defaults = {
+        DEFAULT_SWCLK_HZ, DEFAULT_IDCODE, 0, 0, DEFAULT_TAR_WRAP,
+        0, DEFAULT_FLASH_SIZE, DEFAULT_SECTOR_SIZE, DEFAULT_PAGE_SIZE,
+        DEFAULT_RAM_START, DEFAULT_RAM_SIZE,
+        DEFAULT_ERASE_CHIP_NS, DEFAULT_ERASE_SECTOR_NS, DEFAULT_PROGRAM_NS, DEFAULT_SYSCALL_NS
+    };
+    cfg = config ? *config : defaults;
+    if (0 == cfg.swclk_hz) cfg.swclk_hz = defaults.swclk_hz;
+    if (0 == cfg.idcode) cfg.idcode = defaults.idcode;
+    if (0 == cfg.tar_wrap) cfg.tar_wrap = defaults.tar_wrap;
+    if (0 == cfg.flash_size) cfg.flash_size = defaults.flash_size;
+    if (0 == cfg.sector_size) cfg.sector_size = defaults.sector_size;
+    if (0 == cfg.page_size) cfg.page_size = defaults.page_size;
+    if (0 == cfg.ram_start) cfg.ram_start = defaults.ram_start;
+    if (0 == cfg.ram_size) cfg.ram_size = defaults.ram_size;
+
+    free(flash_mem);
+    free(ram_mem);
+    free(page_written);
+    flash_mem = (uint8_t *)malloc(cfg.flash_size);
+    ram_mem = (uint8_t *)malloc(cfg.ram_size);
+    page_written = (uint8_t *)calloc(cfg.flash_size / cfg.page_size, 1);
+    memset(flash_mem, 0xff, cfg.flash_size);
+    // power on RAM contents are random
+    srand(1);
+    {
+        uint32_t i;
+        for (i = 0; i < cfg.ram_size; i++) {
+            ram_mem[i] = (uint8_t)rand();
+        }
+    }
+    memset(&stats, 0, sizeof(stats));
+    memset(&wire, 0, sizeof(wire));
+    memset(&dp, 0, sizeof(dp));
+    memset(&core, 0, sizeof(core));
+    wire.swclk = 1;
+    wire.target_bit = 1;
+    dp.need_idcode = 1;
+    core.nreset = 1;
+    period_ps = 1000000000000ULL / cfg.swclk_hz;
+    time_ps = 0;
+    core_reset();
+}
+
+void swd_model_get_stats(swd_model_stats_t *out)
+{
+    stats.time_ns = time_ps / 1000;
+    *out = stats;
+}
+
+void swd_model_delay(uint64_t ns)
+{
+    time_ps += ns * 1000;
+}
+
+const uint8_t *swd_model_flash(void)
+{
+    return flash_mem;
+}
+
+void swd_model_swclk(uint32_t level)
+{
+    if (level && !wire.swclk) {
+        clock_edge();
+    }
+    wire.swclk = level ? 1 : 0;
+}
+
+void swd_model_swdio_out(uint32_t bit)
+{
+    wire.host_bit = bit & 1;
+}
+
+uint32_t swd_model_swdio_in(void)
+{
+    // pulled up when nobody drives the line
+    return wire.host_oe ? wire.host_bit : wire.target_bit;
+}
+
+void swd_model_swdio_oe(uint32_t enable)
+{
+    wire.host_oe = enable ? 1 : 0;
+}
+
+void swd_model_nreset(uint32_t level)
+{
+    level = level ? 1 : 0;
+    if (!level) {
+        core.halted = 0;
+        core.running_algo = 0;
+    }
+    else if (!core.nreset) {
+        core_reset();
+    }
+    core.nreset = level;
+}
+
+uint32_t swd_model_nreset_in(void)
+{
+    return core.nreset;
+}
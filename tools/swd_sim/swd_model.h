@@ -0,0 +1,104 @@
+/* CMSIS-DAP Interface Firmware
+ * Copyright (c) 2009-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SWD_MODEL_H
+#define SWD_MODEL_H
+
+/** \ingroup swd_sim
+    @{
+ */
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+/** Parameters of the simulated target. Times are in nanoseconds
+ */
+typedef struct {
+    uint32_t swclk_hz;          /*!< SWCLK frequency used to turn clock cycles into time */
+    uint32_t idcode;            /*!< Value returned by a DP IDCODE read */
+    uint32_t wait_every;        /*!< Answer every Nth AP access with WAIT. 0 never injects */
+    uint32_t ap_busy_cycles;    /*!< SWCLK cycles the MEM-AP answers WAIT after a memory write */
+    uint32_t tar_wrap;          /*!< Boundary the MEM-AP auto increment wraps at */
+    uint32_t flash_start;       /*!< Flash base address */
+    uint32_t flash_size;        /*!< Flash size in bytes */
+    uint32_t sector_size;       /*!< Erase granularity of the flash controller */
+    uint32_t page_size;         /*!< Most bytes the ProgramPage entry accepts in one call */
+    uint32_t ram_start;         /*!< RAM base address */
+    uint32_t ram_size;          /*!< RAM size in bytes */
+    uint32_t erase_chip_ns;     /*!< Busy time of a mass erase */
+    uint32_t erase_sector_ns;   /*!< Busy time of a sector erase */
+    uint32_t program_ns;        /*!< Busy time per 8 bytes programmed */
+    uint32_t syscall_ns;        /*!< Fixed busy time of every flash algorithm call */
+} swd_model_cfg_t;
+
+/** Counters kept by the model. All of them only ever increase
+ */
+typedef struct {
+    uint64_t swclk_cycles;      /*!< Rising SWCLK edges */
+    uint64_t transactions;      /*!< Well formed SWD packet requests */
+    uint64_t ack_wait;          /*!< Requests answered with WAIT */
+    uint64_t ack_fault;         /*!< Requests answered with FAULT */
+    uint64_t no_response;       /*!< Requests the target ignored */
+    uint64_t time_ns;           /*!< Simulated wall time */
+    uint64_t syscalls;          /*!< Flash algorithm entries run */
+    uint64_t bytes_programmed;  /*!< Bytes written by the flash controller */
+    uint64_t sectors_erased;    /*!< Sectors erased by the flash controller, mass erase included */
+    uint64_t pages_rewritten;   /*!< Pages programmed more than once without an erase in between */
+} swd_model_stats_t;
+
+/** Reset the target model and load the defaults for any zero parameters
+    @param cfg parameters of the target. NULL uses the defaults
+    @return none
+ */
+void swd_model_init(const swd_model_cfg_t *cfg);
+
+/** Copy of the counters
+    @param stats filled with the current counters
+    @return none
+ */
+void swd_model_get_stats(swd_model_stats_t *stats);
+
+/** Advance simulated time without clocking SWCLK (probe side delays)
+    @param ns amount of time
+    @return none
+ */
+void swd_model_delay(uint64_t ns);
+
+/** Direct access to the flash contents for checking results
+    @param none
+    @return the flash array, flash_size bytes
+ */
+const uint8_t *swd_model_flash(void);
+
+/** Pin level interface used by the simulated DAP_config.h
+ */
+void swd_model_swclk(uint32_t level);
+void swd_model_swdio_out(uint32_t bit);
+uint32_t swd_model_swdio_in(void);
+void swd_model_swdio_oe(uint32_t enable);
+void swd_model_nreset(uint32_t level);
+uint32_t swd_model_nreset_in(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+/** @} */
+
+#endif